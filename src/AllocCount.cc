@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+//  AllocCount.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "AllocCount.h"
+#include <cstdlib>
+#include <cerrno>
+#include <atomic>
+
+// no dynamic initialization, malloc may be called before static constructors run
+static thread_local int64_t threadAllocs = 0;
+static std::atomic<int64_t> totalAllocs(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t align, size_t size);
+
+//------------------------------------------------------------------------------
+static inline void
+countAlloc() {
+    threadAllocs++;
+    totalAllocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+void*
+malloc(size_t size) {
+    countAlloc();
+    return __libc_malloc(size);
+}
+
+//------------------------------------------------------------------------------
+void*
+calloc(size_t num, size_t size) {
+    countAlloc();
+    return __libc_calloc(num, size);
+}
+
+//------------------------------------------------------------------------------
+void*
+realloc(void* ptr, size_t size) {
+    if (size > 0) {
+        countAlloc();
+    }
+    return __libc_realloc(ptr, size);
+}
+
+//------------------------------------------------------------------------------
+void*
+memalign(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+
+//------------------------------------------------------------------------------
+void*
+aligned_alloc(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+
+//------------------------------------------------------------------------------
+int
+posix_memalign(void** ptr, size_t align, size_t size) {
+    // the alignment must be a power of 2 and a multiple of sizeof(void*)
+    if ((0 == align) || (0 != (align & (align - 1))) || (0 != (align % sizeof(void*)))) {
+        return EINVAL;
+    }
+    countAlloc();
+    void* p = __libc_memalign(align, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+} // extern "C"
+#endif
+
+//------------------------------------------------------------------------------
+bool
+AllocCount::Available() {
+    #if defined(__GLIBC__)
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+//------------------------------------------------------------------------------
+int64_t
+AllocCount::Thread() {
+    return threadAllocs;
+}
+
+//------------------------------------------------------------------------------
+int64_t
+AllocCount::Total() {
+    return totalAllocs.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,28 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class AllocCount
+    @brief counts heap allocations for allocation-free frame checks
+
+    On glibc the malloc family is interposed (forwarding to the glibc
+    implementation) and every allocation is counted, per thread and in
+    total. This includes Oryol::Memory::Alloc, container growth and
+    operator new (the counting is a relaxed atomic increment per
+    allocation). The hook lives in AllocCount.cc in the static voxelcore
+    library, so the linker only pulls it into executables which call
+    AllocCount (VoxelTest and VoxelSim), where it resolves malloc before
+    libc does. Other tools, e.g. RegionBake and VoxelBench, use the plain
+    libc malloc and their allocations are not counted. On other
+    platforms Available() returns false and the counts stay 0.
+*/
+#include "Core/Types.h"
+
+class AllocCount {
+public:
+    /// return true if heap allocations are counted
+    static bool Available();
+    /// number of heap allocations made by the calling thread
+    static int64_t Thread();
+    /// number of heap allocations made by all threads
+    static int64_t Total();
+};
@@ -4,16 +4,24 @@
 #include "Pre.h"
 #include "Camera.h"
 #include "glm/trigonometric.hpp"
+#include "glm/common.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/matrix_access.hpp"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VOXELTEST_SSE (1)
+#include <emmintrin.h>
+#endif
 
 using namespace Oryol;
 
 //------------------------------------------------------------------------------
 void
-Camera::Setup(const glm::vec3 pos, float fov, int dispWidth, int dispHeight, float near, float far) {
-    this->Pos = pos;
-    this->Model = glm::translate(glm::mat4(), pos);
+Camera::Setup(const glm::dvec3& pos, float fov, int dispWidth, int dispHeight, float near, float far) {
+    this->Origin = glm::dvec3(glm::floor(pos.x), 0.0, glm::floor(pos.z));
+    this->Pos = glm::vec3(pos - this->Origin);
+    this->Model = glm::translate(glm::mat4(), this->Pos);
     this->UpdateProj(fov, dispWidth, dispHeight, near, far);
 }
 
@@ -46,6 +54,28 @@ Camera::MoveRotate(const glm::vec3& move, const glm::vec2& rot) {
     this->updateViewProjFrustum();
 }
 
+//------------------------------------------------------------------------------
+bool
+Camera::Rebase(float maxDist) {
+    // shift by the whole units of the position, so that the
+    // world-space position stays exactly the same
+    if ((glm::abs(this->Pos.x) <= maxDist) && (glm::abs(this->Pos.z) <= maxDist)) {
+        return false;
+    }
+    const glm::vec3 shift(glm::floor(this->Pos.x), 0.0f, glm::floor(this->Pos.z));
+    this->Origin += glm::dvec3(shift);
+    this->Pos -= shift;
+    this->Model[3] = glm::vec4(this->Pos, 1.0f);
+    this->updateViewProjFrustum();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+glm::dvec3
+Camera::WorldPos() const {
+    return this->Origin + glm::dvec3(this->Pos);
+}
+
 //------------------------------------------------------------------------------
 bool
 Camera::testPlane(const glm::vec4& p, float x0, float x1, float y0, float y1, float z0, float z1) {
@@ -60,7 +90,7 @@ Camera::testPlane(const glm::vec4& p, float x0, float x1, float y0, float y1, fl
 
 //------------------------------------------------------------------------------
 bool
-Camera::BoxVisible(int x0, int x1, int y0, int y1, int z0, int z1) const {
+Camera::BoxVisible(float x0, float x1, float y0, float y1, float z0, float z1) const {
     // see: https://github.com/nothings/stb/blob/master/tests/caveview/cave_render.c
     for (int i = 0; i < 6; i++) {
         if (!testPlane(this->Frustum[i], x0, x1, y0, y1, z0, z1)) {
@@ -70,6 +100,110 @@ Camera::BoxVisible(int x0, int x1, int y0, int y1, int z0, int z1) const {
     return true;
 }
 
+//------------------------------------------------------------------------------
+float
+Camera::planeDist(const glm::vec4& p, float x0, float x1, float y0, float y1, float z0, float z1) {
+    // same as testPlane, with a normalized plane this is a world-space distance
+    float d=0.0f;
+    d += p.x > 0.0f ? x1 * p.x : x0 * p.x;
+    d += p.y > 0.0f ? y1 * p.y : y0 * p.y;
+    d += p.z > 0.0f ? z1 * p.z : z0 * p.z;
+    d += p.w;
+    return d;
+}
+
+//------------------------------------------------------------------------------
+bool
+Camera::BoxVisible(float x0, float x1, float y0, float y1, float z0, float z1, float& outMargin) const {
+    // a visible box stays visible until it crosses the nearest plane,
+    // an invisible box stays invisible until it comes back across
+    // the plane it is farthest behind
+    float minInside = 1.0e30f;
+    float maxOutside = -1.0f;
+    for (int i = 0; i < 6; i++) {
+        float d = planeDist(this->FrustumNormalized[i], x0, x1, y0, y1, z0, z1);
+        if (d >= 0.0f) {
+            minInside = d < minInside ? d : minInside;
+        }
+        else {
+            maxOutside = -d > maxOutside ? -d : maxOutside;
+        }
+    }
+    if (maxOutside >= 0.0f) {
+        outMargin = maxOutside;
+        return false;
+    }
+    else {
+        outMargin = minInside;
+        return true;
+    }
+}
+
+//------------------------------------------------------------------------------
+uint32_t
+Camera::BoxesVisible(const BoxBatch& boxes, float* outMargins) const {
+    // Same result as BoxVisible() with margin for each box: a box is
+    // visible if its farthest corner is in front of all planes, the
+    // margin is the smallest of those distances (if visible), or the
+    // largest distance behind a plane (if not visible), which is
+    // simply the absolute value of the smallest distance. The plane
+    // sign tests select between the min/max arrays once per plane
+    // for all boxes, so the inner loop is branch-free.
+    o_assert_dbg(boxes.Num <= BoxBatch::MaxNumBoxes);
+    uint32_t mask = 0;
+    int i = 0;
+    #if defined(__AVX__)
+    const int width = 8;
+    for (; i + width <= boxes.Num; i += width) {
+        __m256 minDist = _mm256_set1_ps(1.0e30f);
+        for (int pi = 0; pi < NumFrustumPlanes; pi++) {
+            const glm::vec4& p = this->FrustumNormalized[pi];
+            __m256 d = _mm256_set1_ps(p.w);
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps((p.x > 0.0f ? boxes.X1 : boxes.X0) + i), _mm256_set1_ps(p.x)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps((p.y > 0.0f ? boxes.Y1 : boxes.Y0) + i), _mm256_set1_ps(p.y)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps((p.z > 0.0f ? boxes.Z1 : boxes.Z0) + i), _mm256_set1_ps(p.z)));
+            minDist = _mm256_min_ps(minDist, d);
+        }
+        mask |= uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(minDist, _mm256_setzero_ps(), _CMP_GE_OQ))) << i;
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        _mm256_storeu_ps(outMargins + i, _mm256_and_ps(minDist, absMask));
+    }
+    #endif
+    #if defined(__AVX__) || defined(VOXELTEST_SSE)
+    for (; i + 4 <= boxes.Num; i += 4) {
+        __m128 minDist = _mm_set1_ps(1.0e30f);
+        for (int pi = 0; pi < NumFrustumPlanes; pi++) {
+            const glm::vec4& p = this->FrustumNormalized[pi];
+            __m128 d = _mm_set1_ps(p.w);
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps((p.x > 0.0f ? boxes.X1 : boxes.X0) + i), _mm_set1_ps(p.x)));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps((p.y > 0.0f ? boxes.Y1 : boxes.Y0) + i), _mm_set1_ps(p.y)));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps((p.z > 0.0f ? boxes.Z1 : boxes.Z0) + i), _mm_set1_ps(p.z)));
+            minDist = _mm_min_ps(minDist, d);
+        }
+        mask |= uint32_t(_mm_movemask_ps(_mm_cmpge_ps(minDist, _mm_setzero_ps()))) << i;
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        _mm_storeu_ps(outMargins + i, _mm_and_ps(minDist, absMask));
+    }
+    #endif
+    // scalar remainder (or everything without SIMD support)
+    for (; i < boxes.Num; i++) {
+        float minDist = 1.0e30f;
+        for (int pi = 0; pi < NumFrustumPlanes; pi++) {
+            const glm::vec4& p = this->FrustumNormalized[pi];
+            float d = p.w;
+            d += (p.x > 0.0f ? boxes.X1[i] : boxes.X0[i]) * p.x;
+            d += (p.y > 0.0f ? boxes.Y1[i] : boxes.Y0[i]) * p.y;
+            d += (p.z > 0.0f ? boxes.Z1[i] : boxes.Z0[i]) * p.z;
+            minDist = d < minDist ? d : minDist;
+        }
+        if (minDist >= 0.0f) {
+            mask |= 1<<i;
+        }
+        outMargins[i] = glm::abs(minDist);
+    }
+    return mask;
+}
+
 //------------------------------------------------------------------------------
 void
 Camera::updateViewProjFrustum() {
@@ -90,5 +224,9 @@ Camera::updateViewProjFrustum() {
     this->Frustum[3] = rw - ry;
     this->Frustum[4] = rw + rz;
     this->Frustum[5] = rw - rz;
+    for (int i = 0; i < NumFrustumPlanes; i++) {
+        const glm::vec4& p = this->Frustum[i];
+        this->FrustumNormalized[i] = p / glm::sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
+    }
 }
 
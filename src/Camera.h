@@ -5,23 +5,58 @@
     @brief camera attributes, generated view/proj matrices, clipping
 */
 #include "Core/Types.h"
+#include "Core/Assertion.h"
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 #include "glm/mat4x4.hpp"
 
+/// structure-of-arrays box bounds for batched frustum tests
+struct BoxBatch {
+    static const int MaxNumBoxes = 8;
+    int Num = 0;
+    float X0[MaxNumBoxes];
+    float X1[MaxNumBoxes];
+    float Y0[MaxNumBoxes];
+    float Y1[MaxNumBoxes];
+    float Z0[MaxNumBoxes];
+    float Z1[MaxNumBoxes];
+
+    /// add a box (relative to the camera origin), return its index in the batch
+    int Add(float x0, float x1, float y0, float y1, float z0, float z1) {
+        o_assert_dbg(this->Num < MaxNumBoxes);
+        const int i = this->Num++;
+        this->X0[i] = x0; this->X1[i] = x1;
+        this->Y0[i] = y0; this->Y1[i] = y1;
+        this->Z0[i] = z0; this->Z1[i] = z1;
+        return i;
+    }
+};
+
 class Camera {
 public:
-    /// initialize camera attributes
-    void Setup(const glm::vec3 pos, float fov, int dispWidth, int dispHeight, float near, float far);
+    /// initialize camera attributes, pos is in world space
+    void Setup(const glm::dvec3& pos, float fov, int dispWidth, int dispHeight, float near, float far);
     /// update projection matrix (call when display size changes)
     void UpdateProj(float fov, int dispWidth, int dispHeight, float near, float far);
     /// directly set the model matrix
     void UpdateModel(const glm::mat4& model);
     /// move and rotate relative to current view
     void MoveRotate(const glm::vec3& move, const glm::vec2& rot);
-    /// return true if box is visible
-    bool BoxVisible(int x0, int x1, int y0, int y1, int z0, int z1) const;
-    /// the camera's world-space matrix
+    /// move the origin under the camera if the camera is farther than maxDist away, return true if rebased
+    bool Rebase(float maxDist);
+    /// get the camera position in world space
+    glm::dvec3 WorldPos() const;
+    /// return true if box (relative to the origin) is visible
+    bool BoxVisible(float x0, float x1, float y0, float y1, float z0, float z1) const;
+    /// same as BoxVisible, also return the distance the box can move before the result changes
+    bool BoxVisible(float x0, float x1, float y0, float y1, float z0, float z1, float& outMargin) const;
+    /// test a batch of boxes, return visibility bitmask (bit i set if box i is visible), and the margin of each box
+    uint32_t BoxesVisible(const BoxBatch& boxes, float* outMargins) const;
+    /// world-space position of the floating origin, Pos, the matrices and
+    /// the frustum are relative to it to keep float precision far away
+    /// from the world origin (only moves horizontally in whole units)
+    glm::dvec3 Origin;
+    /// the camera's model matrix (relative to Origin)
     glm::mat4 Model;
     /// the view matrix
     glm::mat4 View;
@@ -32,7 +67,9 @@ public:
     /// view frustum
     static const int NumFrustumPlanes = 6;
     glm::vec4 Frustum[NumFrustumPlanes];
-    /// current camera position
+    /// view frustum with unit-length plane normals
+    glm::vec4 FrustumNormalized[NumFrustumPlanes];
+    /// current camera position (relative to Origin)
     glm::vec3 Pos;
     /// current camera rotation
     glm::vec2 Rot;
@@ -41,4 +78,6 @@ public:
     void updateViewProjFrustum();
     /// test if box is behind plane
     static bool testPlane(const glm::vec4& plane, float x0, float x1, float y0, float y1, float z0, float z1);
+    /// get the distance of the box's farthest corner in front of a normalized plane
+    static float planeDist(const glm::vec4& plane, float x0, float x1, float y0, float y1, float z0, float z1);
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+//------------------------------------------------------------------------------
+//  CameraPath.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "CameraPath.h"
+#include "Core/Log.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+void
+CameraPath::put(const void* ptr, int size) {
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    for (int i = 0; i < size; i++) {
+        this->data.Add(bytes[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+CameraPath::get(void* ptr, int size) {
+    if ((this->readPos + size) > this->data.Size()) {
+        return false;
+    }
+    memcpy(ptr, &this->data[this->readPos], size);
+    this->readPos += size;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+CameraPath::StartRecording(int maxFrames) {
+    this->data.Clear();
+    // with a known length recording never allocates
+    this->data.Reserve(maxFrames > 0 ? maxFrames * MaxFrameSize : 64 * 1024);
+    this->numFrames = 0;
+    this->Rewind();
+}
+
+//------------------------------------------------------------------------------
+void
+CameraPath::Record(const Camera& camera, uint8_t actions) {
+    // the first frame always has the full pose
+    uint8_t flags = actions & (Dig | Place);
+    const bool first = 0 == this->numFrames;
+    if (first || (camera.Origin != this->origin)) {
+        flags |= OriginChanged;
+    }
+    if (first || (camera.Pos != this->pos)) {
+        flags |= PosChanged;
+    }
+    if (first || (camera.Rot != this->rot)) {
+        flags |= RotChanged;
+    }
+    this->put(&flags, sizeof(flags));
+    if (flags & OriginChanged) {
+        this->put(&camera.Origin, sizeof(camera.Origin));
+        this->origin = camera.Origin;
+    }
+    if (flags & PosChanged) {
+        this->put(&camera.Pos, sizeof(camera.Pos));
+        this->pos = camera.Pos;
+    }
+    if (flags & RotChanged) {
+        this->put(&camera.Rot, sizeof(camera.Rot));
+        this->rot = camera.Rot;
+    }
+    this->numFrames++;
+}
+
+//------------------------------------------------------------------------------
+bool
+CameraPath::Save(const char* path) const {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        Log::Warn("CameraPath: failed to create '%s'\n", path);
+        return false;
+    }
+    header hdr;
+    hdr.numFrames = this->numFrames;
+    bool ok = 1 == fwrite(&hdr, sizeof(hdr), 1, fp);
+    if (ok && !this->data.Empty()) {
+        ok = 1 == fwrite(&this->data[0], this->data.Size(), 1, fp);
+    }
+    fclose(fp);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+bool
+CameraPath::Load(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        Log::Warn("CameraPath: failed to open '%s'\n", path);
+        return false;
+    }
+    header hdr;
+    bool ok = (1 == fread(&hdr, sizeof(hdr), 1, fp)) && (Magic == hdr.magic) && (Version == hdr.version);
+    this->data.Clear();
+    if (ok) {
+        fseek(fp, 0, SEEK_END);
+        const int size = int(ftell(fp)) - int(sizeof(hdr));
+        fseek(fp, sizeof(hdr), SEEK_SET);
+        this->data.Reserve(size);
+        for (int i = 0; i < size; i++) {
+            this->data.Add(0);
+        }
+        ok = (size <= 0) || (1 == fread(&this->data[0], size, 1, fp));
+    }
+    fclose(fp);
+    if (!ok) {
+        Log::Warn("CameraPath: '%s' is not a valid camera path\n", path);
+        this->data.Clear();
+        return false;
+    }
+    this->numFrames = hdr.numFrames;
+    this->Rewind();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+CameraPath::Rewind() {
+    this->readPos = 0;
+    this->readFrames = 0;
+}
+
+//------------------------------------------------------------------------------
+bool
+CameraPath::Next(Camera& camera, uint8_t& outActions) {
+    uint8_t flags;
+    if ((this->readFrames >= this->numFrames) || !this->get(&flags, sizeof(flags))) {
+        return false;
+    }
+    if (flags & OriginChanged) {
+        this->get(&this->origin, sizeof(this->origin));
+    }
+    if (flags & PosChanged) {
+        this->get(&this->pos, sizeof(this->pos));
+    }
+    if (flags & RotChanged) {
+        this->get(&this->rot, sizeof(this->rot));
+    }
+    // the rotation part of the model matrix only depends on Rot, and the
+    // translation is Pos, so this gives the recorded matrices exactly
+    camera.Origin = this->origin;
+    camera.Pos = this->pos;
+    camera.Rot = this->rot;
+    camera.MoveRotate(glm::vec3(), glm::vec2());
+    outActions = flags & (Dig | Place);
+    this->readFrames++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int
+CameraPath::NumFrames() const {
+    return this->numFrames;
+}
+
+//------------------------------------------------------------------------------
+int
+CameraPath::NumReplayedFrames() const {
+    return this->readFrames;
+}
@@ -0,0 +1,80 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class CameraPath
+    @brief record and replay per-frame camera poses and edit actions
+
+    Each frame stores the camera pose after all camera updates of the
+    frame (so teleports and origin rebasing are replayed exactly), and
+    the edit actions triggered in the frame. A replayed camera is
+    bit-identical to the recorded one, so the VisTree generates the
+    same jobs in the same order when the same number of jobs is
+    processed per frame.
+
+    File layout (little endian): a header with magic, version, number
+    of frames, then per frame a flags byte followed by only the parts
+    which changed since the previous frame: origin (3 doubles), position
+    (3 floats), rotation (2 floats). An idle frame takes 1 byte.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include "Camera.h"
+
+class CameraPath {
+public:
+    static const uint32_t Magic = 0x50435856;     // 'VXCP'
+    static const uint32_t Version = 1;
+
+    /// edit actions of a frame
+    enum Action : uint8_t {
+        Dig = 1<<0,
+        Place = 1<<1,
+    };
+
+    /// max bytes of a recorded frame (flags, origin, position, rotation)
+    static const int MaxFrameSize = 1 + sizeof(glm::dvec3) + sizeof(glm::vec3) + sizeof(glm::vec2);
+
+    /// start a new recording, reserve room for maxFrames frames (0 for an open-ended recording)
+    void StartRecording(int maxFrames = 0);
+    /// record the camera pose and actions of a frame
+    void Record(const Camera& camera, uint8_t actions);
+    /// write the recorded frames to a file, return false on error
+    bool Save(const char* path) const;
+
+    /// load a recording from a file and start replaying it, return false on error
+    bool Load(const char* path);
+    /// set the camera to the next frame's pose, return false at the end of the recording
+    bool Next(Camera& camera, uint8_t& outActions);
+    /// rewind to the first frame
+    void Rewind();
+
+    /// number of recorded frames
+    int NumFrames() const;
+    /// number of replayed frames
+    int NumReplayedFrames() const;
+
+    enum flags : uint8_t {
+        OriginChanged = 1<<2,
+        PosChanged = 1<<3,
+        RotChanged = 1<<4,
+    };
+    struct header {
+        uint32_t magic = Magic;
+        uint32_t version = Version;
+        uint32_t numFrames = 0;
+        uint32_t pad = 0;
+    };
+    /// append raw bytes to the data
+    void put(const void* ptr, int size);
+    /// read raw bytes from the data, return false at the end
+    bool get(void* ptr, int size);
+
+    Oryol::Array<uint8_t> data;
+    int numFrames = 0;
+    int readPos = 0;
+    int readFrames = 0;
+    // previous pose, only changes are stored
+    glm::dvec3 origin;
+    glm::vec3 pos;
+    glm::vec2 rot;
+};
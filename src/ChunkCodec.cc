@@ -0,0 +1,228 @@
+//------------------------------------------------------------------------------
+//  ChunkCodec.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "ChunkCodec.h"
+#include "Core/Assertion.h"
+#include "Core/Memory/Memory.h"
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+int
+ChunkCodec::MaxEncodedSize(int sizeX, int sizeY, int sizeZ) {
+    // worst case is one 2-byte run per voxel
+    return HeaderSize + 2 * sizeX * sizeY * sizeZ;
+}
+
+//------------------------------------------------------------------------------
+bool
+ChunkCodec::HasSize(const uint8_t* src, int sizeX, int sizeY, int sizeZ) {
+    return (src[1] == sizeX) && (src[2] == sizeY) && (src[3] == sizeZ);
+}
+
+//------------------------------------------------------------------------------
+ChunkCodec::Encoding
+ChunkCodec::GetEncoding(const uint8_t* src) {
+    return (Encoding) src[0];
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkCodec::paletteBits(int numEntries) {
+    return numEntries <= 1 ? 0 : numEntries <= 2 ? 1 : numEntries <= 4 ? 2 : numEntries <= 16 ? 4 : 8;
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkCodec::encodeColumn(const uint8_t* column, int sizeZ, uint8_t* dst) {
+    // a run is 2 bytes: the start value, and the length-1 in the low
+    // 7 bits with the top bit set if the values count up
+    int num = 0;
+    int z = 0;
+    while (z < sizeZ) {
+        const uint8_t value = column[z];
+        int len = 1;
+        bool ramp = false;
+        if (((z + 1) < sizeZ) && (column[z + 1] == value)) {
+            while (((z + len) < sizeZ) && (column[z + len] == value)) {
+                len++;
+            }
+        }
+        else if (((z + 1) < sizeZ) && (column[z + 1] == uint8_t(value + 1))) {
+            ramp = true;
+            while (((z + len) < sizeZ) && (column[z + len] == uint8_t(value + len))) {
+                len++;
+            }
+        }
+        dst[num++] = value;
+        dst[num++] = uint8_t((len - 1) | (ramp ? 0x80 : 0));
+        z += len;
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkCodec::Encode(const uint8_t* blocks, int sizeX, int sizeY, int sizeZ, bool columnsOnly, uint8_t* dst) {
+    o_assert((sizeX < 256) && (sizeY < 256) && (sizeZ <= 128));
+    const int numColumns = sizeX * sizeY;
+    const int numVoxels = numColumns * sizeZ;
+    dst[1] = uint8_t(sizeX);
+    dst[2] = uint8_t(sizeY);
+    dst[3] = uint8_t(sizeZ);
+
+    // run-length encoded columns
+    dst[0] = Columns;
+    int size = HeaderSize;
+    for (int i = 0; i < numColumns; i++) {
+        size += encodeColumn(blocks + i * sizeZ, sizeZ, dst + size);
+    }
+    if (columnsOnly) {
+        return size;
+    }
+
+    // palette with bit-packed indices, if smaller
+    uint8_t paletteIndex[256];
+    bool used[256] = { };
+    for (int i = 0; i < numVoxels; i++) {
+        used[blocks[i]] = true;
+    }
+    int numEntries = 0;
+    for (int i = 0; i < 256; i++) {
+        if (used[i]) {
+            paletteIndex[i] = uint8_t(numEntries++);
+        }
+    }
+    const int bits = paletteBits(numEntries);
+    const int paletteSize = HeaderSize + 1 + numEntries + (numVoxels * bits + 7) / 8;
+    if (paletteSize >= size) {
+        return size;
+    }
+    dst[0] = Palette;
+    dst[HeaderSize] = uint8_t(numEntries - 1);
+    uint8_t* palette = dst + HeaderSize + 1;
+    for (int i = 0; i < 256; i++) {
+        if (used[i]) {
+            palette[paletteIndex[i]] = uint8_t(i);
+        }
+    }
+    uint8_t* packed = palette + numEntries;
+    Memory::Clear(packed, (numVoxels * bits + 7) / 8);
+    if (bits > 0) {
+        for (int i = 0; i < numVoxels; i++) {
+            const int bit = i * bits;
+            packed[bit >> 3] |= paletteIndex[blocks[i]] << (bit & 7);
+        }
+    }
+    return paletteSize;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkCodec::Decode(const uint8_t* src, uint8_t* blocks) {
+    const int numVoxels = src[1] * src[2] * src[3];
+    if (Columns == src[0]) {
+        src += HeaderSize;
+        for (int i = 0; i < numVoxels;) {
+            const uint8_t value = *src++;
+            const uint8_t run = *src++;
+            const int len = (run & 0x7F) + 1;
+            if (run & 0x80) {
+                for (int z = 0; z < len; z++) {
+                    blocks[i++] = uint8_t(value + z);
+                }
+            }
+            else {
+                for (int z = 0; z < len; z++) {
+                    blocks[i++] = value;
+                }
+            }
+        }
+    }
+    else {
+        const int numEntries = src[HeaderSize] + 1;
+        const uint8_t* palette = src + HeaderSize + 1;
+        const uint8_t* packed = palette + numEntries;
+        const int bits = paletteBits(numEntries);
+        const int mask = (1 << bits) - 1;
+        for (int i = 0; i < numVoxels; i++) {
+            const int bit = i * bits;
+            blocks[i] = bits ? palette[(packed[bit >> 3] >> (bit & 7)) & mask] : palette[0];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+ChunkCodec::Validate(const uint8_t* src, int srcSize) {
+    if (srcSize < HeaderSize) {
+        return false;
+    }
+    const int numColumns = src[1] * src[2];
+    const int sizeZ = src[3];
+    if (Columns == src[0]) {
+        // the runs of each column must end exactly at the column's end
+        // (DecodeHeights depends on it) and stay within srcSize
+        int pos = HeaderSize;
+        for (int c = 0; c < numColumns; c++) {
+            int z = 0;
+            while (z < sizeZ) {
+                if ((pos + 2) > srcSize) {
+                    return false;
+                }
+                z += (src[pos + 1] & 0x7F) + 1;
+                pos += 2;
+            }
+            if (z != sizeZ) {
+                return false;
+            }
+        }
+        return true;
+    }
+    else if (Palette == src[0]) {
+        if ((HeaderSize + 1) > srcSize) {
+            return false;
+        }
+        const int numEntries = src[HeaderSize] + 1;
+        const int numVoxels = numColumns * sizeZ;
+        const int size = HeaderSize + 1 + numEntries + (numVoxels * paletteBits(numEntries) + 7) / 8;
+        return size <= srcSize;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkCodec::ExpandHeights(const uint8_t* heights, int numColumns, int sizeZ, uint8_t* blocks) {
+    for (int i = 0; i < numColumns; i++) {
+        const int h = heights[i];
+        uint8_t* column = blocks + i * sizeZ;
+        column[0] = 1;
+        for (int z = 1; z < sizeZ; z++) {
+            column[z] = z < h ? z : 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkCodec::DecodeHeights(const uint8_t* src, uint8_t* heights) {
+    o_assert_dbg(Columns == src[0]);
+    const int numColumns = src[1] * src[2];
+    const int sizeZ = src[3];
+    src += HeaderSize;
+    for (int c = 0; c < numColumns; c++) {
+        int z = 0;
+        int h = sizeZ;
+        while (z < sizeZ) {
+            const uint8_t value = *src++;
+            const uint8_t run = *src++;
+            if ((0 == value) && !(run & 0x80) && (h == sizeZ)) {
+                h = z;
+            }
+            z += (run & 0x7F) + 1;
+        }
+        heights[c] = uint8_t(h);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class ChunkCodec
+    @brief compression of chunk voxel data (used by ChunkStore and RegionFile)
+
+    An encoded chunk is a 4-byte header (encoding, sizeX, sizeY, sizeZ)
+    followed by the payload in one of two encodings:
+
+    - Columns: each voxel column as runs of (value, length), a run either
+      repeats its value or counts up from it (the generator's block type
+      is the voxel's z), a generated column is 3 runs
+    - Palette: the chunk's distinct block types plus 1/2/4/8-bit packed
+      palette indices, for noisy (e.g. edited or checkerboard) chunks
+
+    Voxels are x-major like Volume::Blocks, sizes are array sizes
+    (including the apron).
+*/
+#include "Core/Types.h"
+
+class ChunkCodec {
+public:
+    enum Encoding : uint8_t {
+        Columns = 0,
+        Palette = 1,
+    };
+    static const int HeaderSize = 4;
+
+    /// get the max encoded size of a chunk
+    static int MaxEncodedSize(int sizeX, int sizeY, int sizeZ);
+    /// encode voxels with the smaller encoding (or always Columns), return encoded size
+    static int Encode(const uint8_t* blocks, int sizeX, int sizeY, int sizeZ, bool columnsOnly, uint8_t* dst);
+    /// decode voxels
+    static void Decode(const uint8_t* src, uint8_t* blocks);
+    /// return true if encoded data from an untrusted source decodes within srcSize bytes
+    static bool Validate(const uint8_t* src, int srcSize);
+    /// return true if an encoded chunk has the given size
+    static bool HasSize(const uint8_t* src, int sizeX, int sizeY, int sizeZ);
+    /// get the encoding of an encoded chunk
+    static Encoding GetEncoding(const uint8_t* src);
+    /// expand column heights to generator columns (see HeightField)
+    static void ExpandHeights(const uint8_t* heights, int numColumns, int sizeZ, uint8_t* blocks);
+    /// decode the column heights of a Columns-encoded chunk (where the first empty run starts)
+    static void DecodeHeights(const uint8_t* src, uint8_t* heights);
+
+    /// encode one column as runs, return number of bytes written
+    static int encodeColumn(const uint8_t* column, int sizeZ, uint8_t* dst);
+    /// get number of bits per palette index
+    static int paletteBits(int numEntries);
+};
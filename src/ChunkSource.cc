@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+//  ChunkSource.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "ChunkSource.h"
+#include "Trace.h"
+#include "MemTrack.h"
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Setup(int storeMemory, int chunkSize) {
+    this->Generator.Setup(chunkSize);
+    this->Store.Setup(storeMemory);
+    MemTrack::Alloc(MemTrack::Generator, MemTrack::CPU, sizeof(this->Generator));
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Discard() {
+    this->Store.Discard();
+    this->Edits.Clear();
+    MemTrack::Free(MemTrack::Generator, MemTrack::CPU, sizeof(this->Generator));
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Start(const VisTree::GeomGenJob& job, VisTree& visTree, GeomMesher& mesher) {
+    TRACE_SCOPE("ChunkSource::Start");
+    Chunk chunk;
+    this->Prepare(job, this->Generator, chunk);
+    this->Generate(job, this->Generator, chunk);
+    this->Finish(job, chunk, visTree);
+    StartMesher(chunk, mesher);
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Prepare(const VisTree::GeomGenJob& job, VoxelGenerator& generator, Chunk& chunk) {
+    chunk = Chunk();
+    if (this->Checkerboard) {
+        chunk.Type = Chunk::CheckerboardChunk;
+    }
+    else if (this->Edits.Intersects(VoxelEdits::Apron(job.Bounds, generator.ChunkSize()))) {
+        // edited chunks go through the volume mesher, a stored
+        // chunk only needs the edits made since it was stored
+        chunk.Type = Chunk::VolumeChunk;
+        chunk.Voxels = generator.initVolume();
+        chunk.Loaded = this->Store.Load(job.Bounds, chunk.Voxels, chunk.GeomError, chunk.NumEdits) &&
+                       (chunk.NumEdits <= this->Edits.NumEdits());
+    }
+    else {
+        chunk.Type = Chunk::HeightFieldChunk;
+        chunk.Columns = generator.initHeightField();
+        chunk.Loaded = this->Store.Load(job.Bounds, chunk.Columns);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Generate(const VisTree::GeomGenJob& job, VoxelGenerator& generator, Chunk& chunk) const {
+    switch (chunk.Type) {
+        case Chunk::CheckerboardChunk:
+            chunk.Voxels = generator.GenCheckerboard();
+            break;
+        case Chunk::VolumeChunk:
+            if (!chunk.Loaded) {
+                chunk.Voxels = generator.GenSimplex(job.Bounds);
+                chunk.GeomError = generator.geomError(job.Bounds);
+                chunk.NumEdits = 0;
+            }
+            this->Edits.Apply(job.Bounds, chunk.Voxels, chunk.NumEdits);
+            break;
+        case Chunk::HeightFieldChunk:
+            if (!chunk.Loaded) {
+                chunk.Columns = generator.GenSimplexHeightField(job.Bounds);
+            }
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::Finish(const VisTree::GeomGenJob& job, const Chunk& chunk, VisTree& visTree) {
+    switch (chunk.Type) {
+        case Chunk::CheckerboardChunk:
+            break;
+        case Chunk::VolumeChunk:
+            this->Store.Store(job.Bounds, chunk.Voxels, chunk.GeomError, this->Edits.NumEdits());
+            visTree.ApplyVolume(job.Node, job.Bounds, chunk.Voxels, chunk.GeomError);
+            break;
+        case Chunk::HeightFieldChunk:
+            if (!chunk.Loaded) {
+                this->Store.Store(job.Bounds, chunk.Columns);
+            }
+            visTree.ApplyHeights(job.Node, job.Bounds, chunk.Columns);
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkSource::StartMesher(const Chunk& chunk, GeomMesher& mesher) {
+    mesher.Start();
+    if (Chunk::HeightFieldChunk == chunk.Type) {
+        mesher.StartHeightField(chunk.Columns);
+    }
+    else {
+        mesher.StartVolume(chunk.Voxels);
+    }
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+ChunkSource::Brush(const Camera& camera, uint8_t blockType) {
+    // note that voxel space has z up
+    const glm::vec3 forward = -glm::vec3(camera.Model[2]);
+    const glm::dvec3 pos = camera.WorldPos() + glm::dvec3(forward * float(BrushDist));
+    return this->Edits.Sphere(int64_t(glm::floor(pos.x)), int64_t(glm::floor(pos.z)),
+                              int(glm::floor(pos.y)), BrushRadius, blockType);
+}
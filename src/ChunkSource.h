@@ -0,0 +1,68 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class ChunkSource
+    @brief provides the voxel data for geom generation jobs
+
+    Owns the terrain generator, the voxel edits and the chunk store. For
+    each VisTree geom generation job, the chunk's voxels come from the
+    store or the generator (with edits applied), the chunk's heights are
+    recorded in the VisTree, and the mesher is started on the chunk, the
+    caller then calls GeomMesher::Meshify() until done.
+
+    Start() runs the three steps of a chunk in one go, ChunkWorkers
+    splits them: Prepare() and Finish() access the store and the VisTree
+    and must be called on the main thread, Generate() only reads the
+    edits and writes into its generator, so chunks with different
+    generators can be generated in parallel.
+*/
+#include "VoxelGenerator.h"
+#include "VoxelEdits.h"
+#include "ChunkStore.h"
+#include "GeomMesher.h"
+#include "VisTree.h"
+
+class ChunkSource {
+public:
+    /// setup with the memory cap of the chunk store and the chunk size (see VoxelGenerator)
+    void Setup(int storeMemory, int chunkSize);
+    /// discard the chunk source
+    void Discard();
+    /// a chunk on its way from the store or generator to the mesher
+    struct Chunk {
+        enum Type {
+            CheckerboardChunk,
+            VolumeChunk,            // edited chunks
+            HeightFieldChunk,
+        } Type = HeightFieldChunk;
+        bool Loaded = false;        // found in the store, no need to generate
+        Volume Voxels;              // data lives in the generator
+        HeightField Columns;
+        float GeomError = 0.0f;
+        int NumEdits = 0;           // edits already applied to the stored volume
+    };
+
+    /// prepare a job's chunk, and start the mesher on it
+    void Start(const VisTree::GeomGenJob& job, VisTree& visTree, GeomMesher& mesher);
+    /// look up a job's chunk in the store (loaded into the generator's buffers)
+    void Prepare(const VisTree::GeomGenJob& job, VoxelGenerator& generator, Chunk& chunk);
+    /// generate a chunk which wasn't stored and apply the edits, thread-safe for different generators
+    void Generate(const VisTree::GeomGenJob& job, VoxelGenerator& generator, Chunk& chunk) const;
+    /// store a generated chunk and record its heights in the VisTree
+    void Finish(const VisTree::GeomGenJob& job, const Chunk& chunk, VisTree& visTree);
+    /// start the mesher on a chunk
+    static void StartMesher(const Chunk& chunk, GeomMesher& mesher);
+    /// apply the sphere brush in front of the camera (blockType 0 digs), return the edited area
+    VisBounds Brush(const Camera& camera, uint8_t blockType);
+
+    /// distance and radius of the edit brush in front of the camera
+    static const int BrushDist = 24;
+    static const int BrushRadius = 4;
+
+    /// replace the terrain with a worst-case 3D checkerboard
+    bool Checkerboard = false;
+
+    VoxelGenerator Generator;
+    VoxelEdits Edits;
+    ChunkStore Store;
+};
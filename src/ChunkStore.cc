@@ -0,0 +1,300 @@
+//------------------------------------------------------------------------------
+//  ChunkStore.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "ChunkStore.h"
+#include "ChunkCodec.h"
+#include "MemTrack.h"
+#include "Core/Assertion.h"
+#include "Core/Memory/Memory.h"
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Setup(int maxMem) {
+    o_assert(maxMem > 0);
+    this->maxMemory = maxMem;
+    this->numPages = (maxMem + PageSize - 1) / PageSize;
+    this->pages = (uint8_t*) Memory::Alloc(this->numPages * PageSize);
+    this->nextPage.Reserve(this->numPages);
+    this->pageFreeList.Reserve(this->numPages);
+    for (int i = 0; i < this->numPages; i++) {
+        this->nextPage.Add(InvalidIndex);
+    }
+    this->entries.Reserve(this->numPages);
+    this->freeEntries.Reserve(this->numPages);
+    this->index.Reserve(this->numPages);
+    this->Clear();
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Discard() {
+    this->Clear();
+    if (this->scratch) {
+        Memory::Free(this->scratch);
+        Memory::Free(this->voxelScratch);
+        this->scratch = nullptr;
+        this->voxelScratch = nullptr;
+        this->scratchVoxels = 0;
+    }
+    if (this->pages) {
+        Memory::Free(this->pages);
+        this->pages = nullptr;
+        this->numPages = 0;
+    }
+    this->nextPage.Clear();
+    this->pageFreeList.Clear();
+    MemTrack::Resize(MemTrack::Store, MemTrack::CPU, this->trackedBytes, 0);
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Clear() {
+    this->entries.Clear();
+    this->freeEntries.Clear();
+    this->index.Clear();
+    this->pageFreeList.Clear();
+    for (int i = this->numPages - 1; i >= 0; i--) {
+        this->pageFreeList.Add(i);
+    }
+    this->memory = 0;
+    this->rawMemory = 0;
+    this->trackMemory();
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkStore::NumChunks() const {
+    return this->index.Size();
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkStore::CompressedMemory() const {
+    return this->memory;
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkStore::RawMemory() const {
+    return this->rawMemory;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::reserveScratch(int numVoxels) {
+    if (numVoxels > this->scratchVoxels) {
+        if (this->scratch) {
+            Memory::Free(this->scratch);
+            Memory::Free(this->voxelScratch);
+        }
+        this->scratch = (uint8_t*) Memory::Alloc(ChunkCodec::MaxEncodedSize(numVoxels, 1, 1));
+        this->voxelScratch = (uint8_t*) Memory::Alloc(numVoxels);
+        this->scratchVoxels = numVoxels;
+        this->trackMemory();
+    }
+}
+
+//------------------------------------------------------------------------------
+ChunkStore::entry&
+ChunkStore::store(const VisBounds& bounds, int size, int rawSize) {
+    const int numPagesNeeded = (size + PageSize - 1) / PageSize;
+    o_assert(numPagesNeeded <= this->numPages);
+    const key k(bounds);
+    int entryIndex = this->index.FindIndex(k);
+    if (InvalidIndex != entryIndex) {
+        entryIndex = this->index.ValueAtIndex(entryIndex);
+        this->freePages(this->entries[entryIndex]);
+    }
+    // evict before adding a new entry, so that it can't be evicted itself
+    this->evict(numPagesNeeded);
+    if (InvalidIndex == entryIndex) {
+        if (!this->freeEntries.Empty()) {
+            entryIndex = this->freeEntries.PopBack();
+        }
+        else {
+            entryIndex = this->entries.Size();
+            this->entries.Add(entry());
+        }
+        this->index.Add(k, entryIndex);
+    }
+    entry& e = this->entries[entryIndex];
+    e.k = k;
+    // copy the encoded data into a chain of pages
+    int32_t prevPage = InvalidIndex;
+    for (int offset = 0; offset < size; offset += PageSize) {
+        const int32_t page = this->pageFreeList.PopBack();
+        this->nextPage[page] = InvalidIndex;
+        if (InvalidIndex == prevPage) {
+            e.firstPage = page;
+        }
+        else {
+            this->nextPage[prevPage] = page;
+        }
+        prevPage = page;
+        const int num = (size - offset) < PageSize ? (size - offset) : PageSize;
+        Memory::Copy(this->scratch + offset, this->pages + page * PageSize, num);
+    }
+    e.size = size;
+    e.rawSize = rawSize;
+    e.lastUsed = ++this->useCounter;
+    this->memory += size;
+    this->rawMemory += rawSize;
+    return e;
+}
+
+//------------------------------------------------------------------------------
+const uint8_t*
+ChunkStore::data(const entry& e) {
+    o_assert_dbg(InvalidIndex != e.firstPage);
+    if (e.size <= PageSize) {
+        return this->pages + e.firstPage * PageSize;
+    }
+    int offset = 0;
+    for (int32_t page = e.firstPage; InvalidIndex != page; page = this->nextPage[page]) {
+        const int num = (e.size - offset) < PageSize ? (e.size - offset) : PageSize;
+        Memory::Copy(this->pages + page * PageSize, this->scratch + offset, num);
+        offset += num;
+    }
+    return this->scratch;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::freePages(entry& e) {
+    for (int32_t page = e.firstPage; InvalidIndex != page; page = this->nextPage[page]) {
+        this->pageFreeList.Add(page);
+    }
+    e.firstPage = InvalidIndex;
+    this->memory -= e.size;
+    this->rawMemory -= e.rawSize;
+    e.size = 0;
+    e.rawSize = 0;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::remove(int entryIndex) {
+    entry& e = this->entries[entryIndex];
+    this->index.Erase(e.k);
+    this->freePages(e);
+    e = entry();
+    this->freeEntries.Add(entryIndex);
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::evict(int numPagesNeeded) {
+    // a linear search for the least recently used chunk is fine,
+    // evictions only happen when new chunks are generated
+    while (this->pageFreeList.Size() < numPagesNeeded) {
+        int lruIndex = InvalidIndex;
+        for (int i = 0; i < this->entries.Size(); i++) {
+            const entry& e = this->entries[i];
+            if ((InvalidIndex != e.firstPage) && ((InvalidIndex == lruIndex) || (e.lastUsed < this->entries[lruIndex].lastUsed))) {
+                lruIndex = i;
+            }
+        }
+        o_assert(InvalidIndex != lruIndex);
+        this->remove(lruIndex);
+        this->NumEvictions++;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Store(const VisBounds& bounds, const HeightField& hf) {
+    // expand the heights to generator columns (see HeightField)
+    const int sizeZ = hf.SizeZ + 2 * hf.OffsetZ;
+    const int numColumns = hf.ArraySizeX * hf.ArraySizeY;
+    this->reserveScratch(numColumns * sizeZ);
+    ChunkCodec::ExpandHeights(hf.Heights, numColumns, sizeZ, this->voxelScratch);
+    const int size = ChunkCodec::Encode(this->voxelScratch, hf.ArraySizeX, hf.ArraySizeY, sizeZ, true, this->scratch);
+    entry& e = this->store(bounds, size, numColumns * sizeZ);
+    e.geomError = hf.GeomError;
+    e.numEdits = 0;
+    e.heightField = true;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Store(const VisBounds& bounds, const Volume& vol, float geomError, int numEdits) {
+    this->reserveScratch(vol.ArraySizeX * vol.ArraySizeY * vol.ArraySizeZ);
+    const int size = ChunkCodec::Encode(vol.Blocks, vol.ArraySizeX, vol.ArraySizeY, vol.ArraySizeZ, false, this->scratch);
+    entry& e = this->store(bounds, size, vol.ArraySizeX * vol.ArraySizeY * vol.ArraySizeZ);
+    e.geomError = geomError;
+    e.numEdits = numEdits;
+    e.heightField = false;
+}
+
+//------------------------------------------------------------------------------
+bool
+ChunkStore::Load(const VisBounds& bounds, Volume& vol, float& outGeomError, int& outNumEdits) {
+    const int i = this->index.FindIndex(key(bounds));
+    if (InvalidIndex == i) {
+        this->NumMisses++;
+        return false;
+    }
+    entry& e = this->entries[this->index.ValueAtIndex(i)];
+    const uint8_t* data = this->data(e);
+    if (!ChunkCodec::HasSize(data, vol.ArraySizeX, vol.ArraySizeY, vol.ArraySizeZ)) {
+        this->NumMisses++;
+        return false;
+    }
+    ChunkCodec::Decode(data, vol.Blocks);
+    outGeomError = e.geomError;
+    outNumEdits = e.numEdits;
+    e.lastUsed = ++this->useCounter;
+    this->NumHits++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool
+ChunkStore::Load(const VisBounds& bounds, HeightField& hf) {
+    const int i = this->index.FindIndex(key(bounds));
+    if (InvalidIndex == i) {
+        this->NumMisses++;
+        return false;
+    }
+    entry& e = this->entries[this->index.ValueAtIndex(i)];
+    const int sizeZ = hf.SizeZ + 2 * hf.OffsetZ;
+    if (!e.heightField) {
+        this->NumMisses++;
+        return false;
+    }
+    const uint8_t* data = this->data(e);
+    if (!ChunkCodec::HasSize(data, hf.ArraySizeX, hf.ArraySizeY, sizeZ)) {
+        this->NumMisses++;
+        return false;
+    }
+    ChunkCodec::DecodeHeights(data, hf.Heights);
+    hf.GeomError = e.geomError;
+    e.lastUsed = ++this->useCounter;
+    this->NumHits++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::Remove(const VisBounds& bounds) {
+    const int i = this->index.FindIndex(key(bounds));
+    if (InvalidIndex != i) {
+        this->remove(this->index.ValueAtIndex(i));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkStore::trackMemory() {
+    int64_t bytes = int64_t(this->numPages) * PageSize +
+        (this->nextPage.Capacity() + this->pageFreeList.Capacity()) * sizeof(int32_t) +
+        this->entries.Capacity() * sizeof(entry) + this->freeEntries.Capacity() * sizeof(int) +
+        this->index.Capacity() * (sizeof(key) + sizeof(int));
+    if (this->scratch) {
+        bytes += ChunkCodec::MaxEncodedSize(this->scratchVoxels, 1, 1) + this->scratchVoxels;
+    }
+    MemTrack::Resize(MemTrack::Store, MemTrack::CPU, this->trackedBytes, bytes);
+}
@@ -0,0 +1,117 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class ChunkStore
+    @brief compressed in-memory cache of generated and edited chunk voxels
+
+    Chunks are keyed by their bounds (so the same chunk is found again
+    after its node was merged away) and compressed with ChunkCodec.
+    The compressed data lives in fixed-size pages of a pool which is
+    allocated in Setup() (sized by the memory cap), a chunk takes a chain
+    of pages. When a chunk doesn't fit into the free pages, the least
+    recently used chunks are evicted, a chunk that is not in the store is
+    simply generated again. Since each chunk needs at least one page, all
+    bookkeeping arrays are reserved up front as well, so storing and
+    loading chunks doesn't allocate.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include "Core/Containers/Map.h"
+#include "Volume.h"
+#include "HeightField.h"
+#include "VisBounds.h"
+
+class ChunkStore {
+public:
+    /// size of a page of compressed data in bytes
+    static const int PageSize = 1024;
+
+    /// setup the store with a memory cap for the compressed data in bytes
+    void Setup(int maxMemory);
+    /// discard the store
+    void Discard();
+    /// remove all chunks
+    void Clear();
+
+    /// store a generated chunk given by its column heights (replaces a stored chunk)
+    void Store(const VisBounds& bounds, const HeightField& heightField);
+    /// store a chunk volume, numEdits is the number of voxel edits applied to it
+    void Store(const VisBounds& bounds, const Volume& volume, float geomError, int numEdits);
+    /// decompress a chunk into a volume with the same dimensions, return false if not stored
+    bool Load(const VisBounds& bounds, Volume& volume, float& outGeomError, int& outNumEdits);
+    /// decompress a chunk which was stored as height field, return false if not stored or edited
+    bool Load(const VisBounds& bounds, HeightField& heightField);
+    /// remove a chunk
+    void Remove(const VisBounds& bounds);
+
+    /// number of stored chunks
+    int NumChunks() const;
+    /// compressed size of all stored chunks in bytes
+    int CompressedMemory() const;
+    /// uncompressed size of all stored chunks in bytes
+    int RawMemory() const;
+
+    // stats
+    int NumHits = 0;
+    int NumMisses = 0;
+    int NumEvictions = 0;
+
+    struct key {
+        int64_t x0 = 0;
+        int64_t y0 = 0;
+        int64_t size = 0;
+        key() { };
+        key(const VisBounds& b) : x0(b.x0), y0(b.y0), size(b.x1 - b.x0) { };
+        bool operator==(const key& rhs) const {
+            return (this->x0 == rhs.x0) && (this->y0 == rhs.y0) && (this->size == rhs.size);
+        };
+        bool operator<(const key& rhs) const {
+            if (this->size != rhs.size) return this->size < rhs.size;
+            if (this->x0 != rhs.x0) return this->x0 < rhs.x0;
+            return this->y0 < rhs.y0;
+        };
+    };
+    struct entry {
+        key k;
+        int32_t firstPage = Oryol::InvalidIndex;   // page chain of the ChunkCodec-encoded data
+        int size = 0;
+        float geomError = 0.0f;
+        int numEdits = 0;
+        bool heightField = false;       // the chunk is plain generator output
+        uint32_t lastUsed = 0;
+        int rawSize = 0;
+    };
+
+    /// store the compressed scratch buffer as a chunk's data
+    entry& store(const VisBounds& bounds, int size, int rawSize);
+    /// get an entry's encoded data, gathered into the scratch buffer if it spans several pages
+    const uint8_t* data(const entry& e);
+    /// return an entry's pages to the pool
+    void freePages(entry& e);
+    /// free an entry's data and recycle it
+    void remove(int entryIndex);
+    /// make sure the scratch buffers can hold a chunk
+    void reserveScratch(int numVoxels);
+    /// evict least recently used chunks until numPages pages are free
+    void evict(int numPages);
+    /// report the store's memory to MemTrack
+    void trackMemory();
+
+    int maxMemory = 0;
+    int memory = 0;
+    int rawMemory = 0;
+    uint32_t useCounter = 0;
+    Oryol::Map<key, int> index;         // key to entry index
+    Oryol::Array<entry> entries;
+    Oryol::Array<int> freeEntries;
+    // the page pool
+    uint8_t* pages = nullptr;
+    int numPages = 0;
+    Oryol::Array<int32_t> nextPage;     // next page of the same chunk
+    Oryol::Array<int32_t> pageFreeList;
+    // compression output and uncompressed input buffers
+    uint8_t* scratch = nullptr;
+    uint8_t* voxelScratch = nullptr;
+    int scratchVoxels = 0;
+    int64_t trackedBytes = 0;
+};
@@ -0,0 +1,207 @@
+//------------------------------------------------------------------------------
+//  ChunkWorkers.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "ChunkWorkers.h"
+#include "Trace.h"
+#include "MemTrack.h"
+#include "Core/Assertion.h"
+#include "Core/Memory/Memory.h"
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+static uint64_t
+hashBytes(uint64_t h, const void* ptr, int size) {
+    // FNV-1a
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    for (int i = 0; i < size; i++) {
+        h = (h ^ bytes[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkWorkers::Setup(int numThreads, int maxTasks, int maxNumQuads, int chunkSize) {
+    o_assert((numThreads > 0) && (maxTasks > 0));
+    this->Tasks.Reserve(maxTasks);
+    for (int i = 0; i < maxTasks; i++) {
+        Task* task = Memory::New<Task>();
+        task->Generator = Memory::New<VoxelGenerator>();
+        task->Generator->Setup(chunkSize);
+        task->Mesher.Setup(maxNumQuads);
+        task->Geoms.Reserve(16);
+        MemTrack::Alloc(MemTrack::Generator, MemTrack::CPU, sizeof(VoxelGenerator));
+        this->Tasks.Add(task);
+    }
+    this->quit = false;
+    this->numIdleWorkers = 0;
+    this->threads.Reserve(numThreads - 1);
+    for (int i = 1; i < numThreads; i++) {
+        this->threads.Add(Memory::New<std::thread>(&ChunkWorkers::workerLoop, this));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkWorkers::Discard() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->quit = true;
+    }
+    this->startCond.notify_all();
+    for (std::thread* thread : this->threads) {
+        thread->join();
+        Memory::Delete(thread);
+    }
+    this->threads.Clear();
+    for (Task* task : this->Tasks) {
+        task->Mesher.Discard();
+        if (task->Vertices) {
+            Memory::Free(task->Vertices);
+        }
+        MemTrack::Resize(MemTrack::Mesher, MemTrack::CPU, task->trackedBytes, 0);
+        MemTrack::Free(MemTrack::Generator, MemTrack::CPU, sizeof(VoxelGenerator));
+        Memory::Delete(task->Generator);
+        Memory::Delete(task);
+    }
+    this->Tasks.Clear();
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkWorkers::NumThreads() const {
+    return this->threads.Size() + 1;
+}
+
+//------------------------------------------------------------------------------
+int
+ChunkWorkers::MaxTasks() const {
+    return this->Tasks.Size();
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkWorkers::Run(int num, ChunkSource& src, VisTree& visTree) {
+    TRACE_SCOPE("ChunkWorkers::Run");
+    o_assert_dbg(num <= this->Tasks.Size());
+    for (int i = 0; i < num; i++) {
+        Task& task = *this->Tasks[i];
+        src.Prepare(task.Job, *task.Generator, task.Chunk);
+    }
+    if (this->threads.Empty()) {
+        for (int i = 0; i < num; i++) {
+            this->work(*this->Tasks[i], src);
+        }
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->source = &src;
+            this->numTasks = num;
+            this->nextTask = 0;
+            this->numIdleWorkers = 0;
+            this->batch++;
+        }
+        this->startCond.notify_all();
+        int i;
+        while ((i = this->nextTask.fetch_add(1)) < num) {
+            this->work(*this->Tasks[i], src);
+        }
+        // wait for the workers to finish their last task
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->doneCond.wait(guard, [this] { return this->numIdleWorkers == this->threads.Size(); });
+    }
+    for (int i = 0; i < num; i++) {
+        Task& task = *this->Tasks[i];
+        src.Finish(task.Job, task.Chunk, visTree);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkWorkers::workerLoop() {
+    int lastBatch = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->startCond.wait(guard, [this, lastBatch] { return this->quit || (this->batch != lastBatch); });
+            if (this->quit) {
+                return;
+            }
+            lastBatch = this->batch;
+        }
+        int i;
+        while ((i = this->nextTask.fetch_add(1)) < this->numTasks) {
+            this->work(*this->Tasks[i], *this->source);
+        }
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->numIdleWorkers++;
+        }
+        this->doneCond.notify_one();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ChunkWorkers::work(Task& task, const ChunkSource& src) {
+    TRACE_SCOPE("ChunkWorkers::work");
+    src.Generate(task.Job, *task.Generator, task.Chunk);
+    ChunkSource::StartMesher(task.Chunk, task.Mesher);
+    task.Geoms.Clear();
+    int numBytes = 0;
+    GeomMesher::Result meshResult;
+    do {
+        meshResult = task.Mesher.Meshify();
+        if (meshResult.NumQuads > 0) {
+            if ((numBytes + meshResult.NumBytes) > task.VerticesCapacity) {
+                // grows during warm-up only
+                int capacity = task.VerticesCapacity > 0 ? task.VerticesCapacity : meshResult.NumBytes;
+                while (capacity < (numBytes + meshResult.NumBytes)) {
+                    capacity *= 2;
+                }
+                uint8_t* vertices = (uint8_t*) Memory::Alloc(capacity);
+                if (task.Vertices) {
+                    Memory::Copy(task.Vertices, vertices, numBytes);
+                    Memory::Free(task.Vertices);
+                }
+                task.Vertices = vertices;
+                task.VerticesCapacity = capacity;
+                MemTrack::Resize(MemTrack::Mesher, MemTrack::CPU, task.trackedBytes, capacity);
+            }
+            Geom geom;
+            geom.Offset = numBytes;
+            geom.NumBytes = meshResult.NumBytes;
+            geom.NumQuads = meshResult.NumQuads;
+            geom.Scale = meshResult.Scale;
+            geom.TexTranslate = meshResult.TexTranslate;
+            Memory::Copy(meshResult.Vertices, task.Vertices + numBytes, meshResult.NumBytes);
+            numBytes += meshResult.NumBytes;
+            task.Geoms.Add(geom);
+        }
+    }
+    while (!meshResult.VolumeDone);
+
+    if (this->Hashing) {
+        const uint64_t basis = 14695981039346656037ull;
+        const ChunkSource::Chunk& chunk = task.Chunk;
+        if (ChunkSource::Chunk::HeightFieldChunk == chunk.Type) {
+            const HeightField& hf = chunk.Columns;
+            task.VoxelHash = hashBytes(basis, hf.Heights, hf.ArraySizeX * hf.ArraySizeY);
+            task.VoxelHash = hashBytes(task.VoxelHash, &hf.GeomError, sizeof(hf.GeomError));
+        }
+        else {
+            const Volume& vol = chunk.Voxels;
+            task.VoxelHash = hashBytes(basis, vol.Blocks, vol.ArraySizeX * vol.ArraySizeY * vol.ArraySizeZ);
+        }
+        task.MeshHash = basis;
+        for (const Geom& geom : task.Geoms) {
+            task.MeshHash = hashBytes(task.MeshHash, &geom.NumQuads, sizeof(geom.NumQuads));
+            task.MeshHash = hashBytes(task.MeshHash, &geom.Scale, sizeof(geom.Scale));
+            task.MeshHash = hashBytes(task.MeshHash, &geom.TexTranslate, sizeof(geom.TexTranslate));
+            task.MeshHash = hashBytes(task.MeshHash, task.Vertices + geom.Offset, geom.NumBytes);
+        }
+    }
+}
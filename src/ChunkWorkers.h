@@ -0,0 +1,81 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class ChunkWorkers
+    @brief generate and meshify a batch of geom jobs on several threads
+
+    The caller pops up to MaxTasks() jobs into Tasks and calls Run(),
+    which prepares the chunks on the calling thread, generates and
+    meshifies them in parallel (the calling thread works too) and
+    finishes them on the calling thread in task order. Each task has its
+    own generator and mesher and the meshes are copied into the task,
+    so a task's output doesn't depend on which thread ran it, and the
+    store and VisTree are only touched in task order. With one thread
+    no threads are started.
+
+    With Hashing enabled, each task also gets a hash of its chunk's
+    voxels and of its mesh output, to compare runs with different
+    numbers of threads.
+*/
+#include "ChunkSource.h"
+#include "Core/Containers/Array.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class ChunkWorkers {
+public:
+    /// setup with the number of threads (including the calling thread), tasks per batch and chunk size
+    void Setup(int numThreads, int maxTasks, int maxNumQuads, int chunkSize);
+    /// discard the workers, stops the threads
+    void Discard();
+    /// number of threads including the calling thread
+    int NumThreads() const;
+    /// max number of tasks per batch
+    int MaxTasks() const;
+    /// run the first numTasks tasks, blocks until all are done
+    void Run(int numTasks, ChunkSource& source, VisTree& visTree);
+
+    /// a meshified geom of a task, the vertices are in the task's vertex buffer
+    struct Geom {
+        int Offset = 0;
+        int NumBytes = 0;
+        int NumQuads = 0;
+        glm::vec3 Scale;
+        glm::vec3 TexTranslate;
+    };
+    /// a job and its results
+    struct Task {
+        VisTree::GeomGenJob Job;
+        ChunkSource::Chunk Chunk;
+        Oryol::Array<Geom> Geoms;
+        uint8_t* Vertices = nullptr;
+        int VerticesCapacity = 0;
+        uint64_t VoxelHash = 0;
+        uint64_t MeshHash = 0;
+
+        VoxelGenerator* Generator = nullptr;
+        GeomMesher Mesher;
+        int64_t trackedBytes = 0;
+    };
+    Oryol::Array<Task*> Tasks;
+    /// hash each task's voxels and mesh output
+    bool Hashing = false;
+
+    /// generate and meshify a task (on any thread)
+    void work(Task& task, const ChunkSource& source);
+    /// worker thread function
+    void workerLoop();
+
+    const ChunkSource* source = nullptr;
+    int numTasks = 0;
+    std::atomic<int> nextTask;
+    std::mutex lock;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    int batch = 0;
+    int numIdleWorkers = 0;
+    bool quit = false;
+    Oryol::Array<std::thread*> threads;
+};
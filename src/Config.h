@@ -7,12 +7,20 @@
 
 class Config {
 public:
+    // default chunk size along x and y, 16 to 64 can be selected at startup (see Settings)
     static const int ChunkSizeXY = 32;
+    static const int MinChunkSizeXY = 16;
+    static const int MaxChunkSizeXY = 64;
     static const int ChunkSizeZ = 32;
     static const int NumLevels = 5;
     static const int MapDimChunks = (1<<(NumLevels-1));   // size of whole map in item chunks    
-    static const int MapDimVoxels = MapDimChunks * Config::ChunkSizeXY;    // size of whole map in voxels
+    // size of whole map in voxels (the noise scale), independent of the chunk size
+    static const int MapDimVoxels = MapDimChunks * 32;
     static const int GeomMaxNumVertices = (1<<15);
     static const int GeomMaxNumQuads = GeomMaxNumVertices / 4;
     static const int GeomMaxNumIndices = GeomMaxNumQuads * 6;
+    // large geoms, only used in 32-bit index mode
+    static const int GeomLargeMaxNumVertices = (1<<17);
+    static const int GeomLargeMaxNumQuads = GeomLargeMaxNumVertices / 4;
+    static const int GeomLargeMaxNumIndices = GeomLargeMaxNumQuads * 6;
 };
\ No newline at end of file
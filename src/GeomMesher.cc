@@ -4,10 +4,18 @@
 #include "Pre.h"
 #define STB_VOXEL_RENDER_IMPLEMENTATION
 #include "GeomMesher.h"
+#include "Trace.h"
+#include "MemTrack.h"
+#include "Core/Memory/Memory.h"
 
 //------------------------------------------------------------------------------
 void
-GeomMesher::Setup() {
+GeomMesher::Setup(int maxNumQuads) {
+    o_assert_dbg(nullptr == this->vertices);
+    this->maxNumQuads = maxNumQuads;
+    this->verticesSize = maxNumQuads * 4 * sizeof(vertex);
+    this->vertices = (vertex*) Oryol::Memory::Alloc(this->verticesSize);
+    MemTrack::Alloc(MemTrack::Mesher, MemTrack::CPU, this->verticesSize);
     stbvox_init_mesh_maker(&this->meshMaker);
     stbvox_set_default_mesh(&this->meshMaker, 0);
 }
@@ -15,19 +23,24 @@ GeomMesher::Setup() {
 //------------------------------------------------------------------------------
 void
 GeomMesher::Discard() {
-    // nothing to so here
+    if (this->vertices) {
+        Oryol::Memory::Free(this->vertices);
+        MemTrack::Free(MemTrack::Mesher, MemTrack::CPU, this->verticesSize);
+        this->vertices = nullptr;
+    }
 }
 
 //------------------------------------------------------------------------------
 void
 GeomMesher::Start() {
     stbvox_reset_buffers(&this->meshMaker);
-    stbvox_set_buffer(&this->meshMaker, 0, 0, this->vertices, sizeof(this->vertices));
+    stbvox_set_buffer(&this->meshMaker, 0, 0, this->vertices, this->verticesSize);
 }
 
 //------------------------------------------------------------------------------
 void
 GeomMesher::StartVolume(const Volume& vol) {
+    this->heightFieldMode = false;
     const int strideX = vol.ArraySizeY * vol.ArraySizeZ;
     const int strideY = vol.ArraySizeZ;
     stbvox_set_input_stride(&this->meshMaker, strideX, strideY);
@@ -41,9 +54,27 @@ GeomMesher::StartVolume(const Volume& vol) {
     desc->color = vol.Blocks;
 }
 
+//------------------------------------------------------------------------------
+void
+GeomMesher::StartHeightField(const HeightField& hf) {
+    this->heightFieldMode = true;
+    this->heightField = hf;
+    this->curX = hf.OffsetX;
+    this->curY = hf.OffsetY;
+    this->numQuads = 0;
+}
+
 //------------------------------------------------------------------------------
 GeomMesher::Result
 GeomMesher::Meshify() {
+    TRACE_SCOPE("GeomMesher::Meshify");
+    if (this->heightFieldMode) {
+        switch (this->heightField.SizeX) {
+            case 16: return this->meshifyHeightField<16>();
+            case 32: return this->meshifyHeightField<32>();
+            default: return this->meshifyHeightField<64>();
+        }
+    }
     Result result;
     int res = stbvox_make_mesh(&this->meshMaker);
 
@@ -65,7 +96,91 @@ GeomMesher::Meshify() {
     if (0 == res) {
         result.BufferFull = true;
         stbvox_reset_buffers(&this->meshMaker);
-        stbvox_set_buffer(&this->meshMaker, 0, 0, this->vertices, sizeof(this->vertices));
+        stbvox_set_buffer(&this->meshMaker, 0, 0, this->vertices, this->verticesSize);
+    }
+    else {
+        result.VolumeDone = true;
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+void
+GeomMesher::writeQuad(int x, int y, int z, int face) {
+    // this produces the exact same vertices as stb_voxel_render for
+    // a plain block (no lighting, blocktype and color are both z)
+    const uint32_t base = stbvox_vertex_encode(x, y, z, 63, 0);
+    stbvox_mesh_face faceData;
+    faceData.tex1 = z;
+    faceData.tex2 = 0;
+    faceData.color = z;
+    faceData.face_info = face<<2;
+    uint32_t attrFace;
+    static_assert(sizeof(faceData) == sizeof(attrFace), "unexpected stbvox_mesh_face size");
+    Oryol::Memory::Copy(&faceData, &attrFace, sizeof(attrFace));
+    vertex* v = &this->vertices[this->numQuads * 4];
+    for (int i = 0; i < 4; i++) {
+        v[i].attr_vertex = base + stbvox_vmesh_delta_normal[face][i];
+        v[i].attr_face = attrFace;
+    }
+    this->numQuads++;
+}
+
+//------------------------------------------------------------------------------
+template<int SIZE> GeomMesher::Result
+GeomMesher::meshifyHeightField() {
+    // emits a top face per column and side faces down to the neighbour
+    // column's height, the bottom layer (z < OffsetZ) is never visible
+    const HeightField& hf = this->heightField;
+    o_assert_dbg((hf.SizeX == SIZE) && (hf.SizeY == SIZE) && (hf.ArraySizeY == SIZE + 2));
+    const uint8_t* heights = hf.Heights;
+    const int strideX = SIZE + 2;
+    const int x1 = hf.OffsetX + SIZE;
+    const int y1 = hf.OffsetY + SIZE;
+    const int z0 = hf.OffsetZ;
+    const int z1 = hf.OffsetZ + hf.SizeZ;
+    const int maxColumnQuads = 1 + 4 * hf.SizeZ;
+    static const int neighbours[4][3] = {
+        { 1, 0, STBVOX_FACE_east },
+        { 0, 1, STBVOX_FACE_north },
+        { -1, 0, STBVOX_FACE_west },
+        { 0, -1, STBVOX_FACE_south },
+    };
+
+    Result result;
+    result.Scale = glm::vec3(1.0f);
+    result.Translate = glm::vec3(0.0f);
+    result.TexTranslate = glm::vec3(0.0f);
+    for (; this->curX < x1; this->curX++) {
+        for (; this->curY < y1; this->curY++) {
+            if ((this->numQuads + maxColumnQuads) > this->maxNumQuads) {
+                result.BufferFull = true;
+                break;
+            }
+            const int x = this->curX;
+            const int y = this->curY;
+            const int h = heights[x * strideX + y];
+            const int zTop = h < z1 ? h : z1;
+            if ((h - 1) >= z0 && (h - 1) < z1) {
+                this->writeQuad(x, y, h - 1, STBVOX_FACE_up);
+            }
+            for (const auto& n : neighbours) {
+                const int hn = heights[(x + n[0]) * strideX + (y + n[1])];
+                for (int z = (hn > z0 ? hn : z0); z < zTop; z++) {
+                    this->writeQuad(x, y, z, n[2]);
+                }
+            }
+        }
+        if (result.BufferFull) {
+            break;
+        }
+        this->curY = hf.OffsetY;
+    }
+    result.NumQuads = this->numQuads;
+    result.NumBytes = this->numQuads * 4 * sizeof(vertex);
+    result.Vertices = this->vertices;
+    if (result.BufferFull) {
+        this->numQuads = 0;
     }
     else {
         result.VolumeDone = true;
@@ -3,9 +3,13 @@
 /**
     @class GeomMesher
     @brief meshify volumes into geoms
+
+    Volumes of any size go through stb_voxel_render, height fields
+    through a mesher loop which is instantiated for each chunk size
+    (see VoxelGenerator).
 */
 #include "Volume.h"
-#include "GeomPool.h"
+#include "HeightField.h"
 #include "Config.h"
 #include "glm/vec3.hpp"
 
@@ -27,8 +31,8 @@ public:
         glm::vec3 TexTranslate;
     };
 
-    /// setup the geom mesher
-    void Setup();
+    /// setup the geom mesher, maxNumQuads is the capacity of a single geom
+    void Setup(int maxNumQuads);
     /// discard the geom mesher
     void Discard();
 
@@ -36,13 +40,28 @@ public:
     void Start();
     /// start a new volume
     void StartVolume(const Volume& volume);
+    /// start a new height field (bypasses stb_voxel_render)
+    void StartHeightField(const HeightField& heightField);
     /// do one meshify pass, continue to call until VolumeDone
     Result Meshify();
 
 private:
+    /// meshify pass for height field input, instantiated for each chunk size
+    template<int SIZE> Result meshifyHeightField();
+    /// write one quad in stb_voxel_render's mode 30 vertex format
+    void writeQuad(int x, int y, int z, int face);
+
     stbvox_mesh_maker meshMaker;
+    bool heightFieldMode = false;
+    HeightField heightField;
+    int curX = 0;
+    int curY = 0;
+    int numQuads = 0;
+    int maxNumQuads = 0;
     struct vertex {
         uint32_t attr_vertex = 0;
         uint32_t attr_face = 0;
-    } vertices[Config::GeomMaxNumVertices];
+    };
+    vertex* vertices = nullptr;
+    int verticesSize = 0;
 };
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include "Pre.h"
 #include "GeomPool.h"
 #include "Config.h"
+#include "MemTrack.h"
 #include "Gfx/Gfx.h"
+#include "Core/Memory/Memory.h"
 #include "glm/geometric.hpp"
 #include "glm/gtc/random.hpp"
 
@@ -12,27 +14,48 @@ using namespace Oryol;
 
 //------------------------------------------------------------------------------
 void
-GeomPool::Setup(const GfxSetup& gfxSetup) {
+GeomPool::Setup(const GfxSetup& gfxSetup, bool index32) {
+    o_assert(this->NumGeoms > 0);
+    this->Index32 = index32;
+    this->Geoms.Reserve(this->NumGeoms + NumLargeGeoms);
+    for (int i = 0; i < this->NumGeoms + NumLargeGeoms; i++) {
+        this->Geoms.Add();
+    }
 
-    // setup a static mesh with only indices which is shared by all geom meshes
-    uint16_t indices[Config::GeomMaxNumIndices];
-    for (int quadIndex = 0; quadIndex < Config::GeomMaxNumQuads; quadIndex++) {
-        int baseVertexIndex = quadIndex * 4;
-        int ii = quadIndex * 6;
-        indices[ii]   = baseVertexIndex + 0;
-        indices[ii+1] = baseVertexIndex + 1;
-        indices[ii+2] = baseVertexIndex + 2;
-        indices[ii+3] = baseVertexIndex + 0;
-        indices[ii+4] = baseVertexIndex + 2;
-        indices[ii+5] = baseVertexIndex + 3;
+    // setup a static mesh with only indices which is shared by all geom meshes,
+    // it is sized for the biggest geom (small geoms use the first part)
+    const int numQuads = this->MaxNumQuads();
+    const int numIndices = numQuads * 6;
+    const IndexType::Code indexType = index32 ? IndexType::Index32 : IndexType::Index16;
+    const int indicesSize = numIndices * IndexType::ByteSize(indexType);
+    void* indices = Memory::Alloc(indicesSize);
+    MemTrack::Alloc(MemTrack::Geoms, MemTrack::CPU, indicesSize);
+    for (int quadIndex = 0; quadIndex < numQuads; quadIndex++) {
+        uint32_t baseVertexIndex = quadIndex * 4;
+        const uint32_t quad[6] = {
+            baseVertexIndex + 0, baseVertexIndex + 1, baseVertexIndex + 2,
+            baseVertexIndex + 0, baseVertexIndex + 2, baseVertexIndex + 3
+        };
+        for (int i = 0; i < 6; i++) {
+            const int ii = quadIndex * 6 + i;
+            if (index32) {
+                ((uint32_t*)indices)[ii] = quad[i];
+            }
+            else {
+                ((uint16_t*)indices)[ii] = uint16_t(quad[i]);
+            }
+        }
     }
     auto meshSetup = MeshSetup::FromData(Usage::InvalidUsage, Usage::Immutable);
     meshSetup.NumVertices = 0;
-    meshSetup.NumIndices  = Config::GeomMaxNumIndices;
-    meshSetup.IndicesType = IndexType::Index16;
+    meshSetup.NumIndices  = numIndices;
+    meshSetup.IndicesType = indexType;
     meshSetup.DataVertexOffset = InvalidIndex;
     meshSetup.DataIndexOffset = 0;
-    this->IndexMesh = Gfx::CreateResource(meshSetup, indices, sizeof(indices));
+    this->IndexMesh = Gfx::CreateResource(meshSetup, indices, indicesSize);
+    Memory::Free(indices);
+    MemTrack::Free(MemTrack::Geoms, MemTrack::CPU, indicesSize);
+    this->gpuBytes = indicesSize;
 
     // setup shader params template
     Shader::VSParams vsParams;
@@ -62,12 +85,29 @@ GeomPool::Setup(const GfxSetup& gfxSetup) {
     // setup items
     meshSetup = MeshSetup::Empty(Config::GeomMaxNumVertices, Usage::Dynamic);
     meshSetup.Layout = pips.Layouts[1];
-    for (auto& geom : this->Geoms) {
+    for (int i = 0; i < this->NumGeoms; i++) {
+        auto& geom = this->Geoms[i];
         geom.VSParams = vsParams;
         geom.NumQuads = 0;
         geom.Mesh = Gfx::CreateResource(meshSetup);
     }
-    this->freeGeoms.Reserve(NumGeoms);
+    this->gpuBytes += int64_t(this->NumGeoms) * Config::GeomMaxNumVertices * meshSetup.Layout.ByteSize();
+    if (index32) {
+        meshSetup = MeshSetup::Empty(Config::GeomLargeMaxNumVertices, Usage::Dynamic);
+        meshSetup.Layout = pips.Layouts[1];
+        for (int i = this->NumGeoms; i < this->NumGeoms+NumLargeGeoms; i++) {
+            auto& geom = this->Geoms[i];
+            geom.VSParams = vsParams;
+            geom.NumQuads = 0;
+            geom.Mesh = Gfx::CreateResource(meshSetup);
+        }
+        this->gpuBytes += int64_t(NumLargeGeoms) * Config::GeomLargeMaxNumVertices * meshSetup.Layout.ByteSize();
+    }
+    this->freeGeoms.Reserve(this->NumGeoms);
+    this->freeLargeGeoms.Reserve(NumLargeGeoms);
+    this->cpuBytes = this->Geoms.Capacity() * sizeof(Geom);
+    MemTrack::Alloc(MemTrack::Geoms, MemTrack::GPU, this->gpuBytes);
+    MemTrack::Alloc(MemTrack::Geoms, MemTrack::CPU, this->cpuBytes);
     this->FreeAll();
 }
 
@@ -77,13 +117,25 @@ GeomPool::Discard() {
     this->IndexMesh.Invalidate();
     this->Pipeline.Invalidate();
     this->freeGeoms.Clear();
+    this->freeLargeGeoms.Clear();
+    this->Geoms.Clear();
+    MemTrack::Free(MemTrack::Geoms, MemTrack::GPU, this->gpuBytes);
+    MemTrack::Free(MemTrack::Geoms, MemTrack::CPU, this->cpuBytes);
+    this->gpuBytes = 0;
+    this->cpuBytes = 0;
 }
 
 //------------------------------------------------------------------------------
 void
 GeomPool::FreeAll() {
     this->freeGeoms.Clear();
-    for (int i = 0; i < NumGeoms; i++) {
+    for (int i = 0; i < this->NumGeoms; i++) {
         this->freeGeoms.Add(i);
     }
+    this->freeLargeGeoms.Clear();
+    if (this->Index32) {
+        for (int i = this->NumGeoms; i < this->NumGeoms+NumLargeGeoms; i++) {
+            this->freeLargeGeoms.Add(i);
+        }
+    }
 }
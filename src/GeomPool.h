@@ -5,43 +5,95 @@
     @brief a pool of reusable voxel meshes
 */
 #include "Volume.h"
+#include "Config.h"
 #include "Gfx/Setup/GfxSetup.h"
-#include "Core/Containers/StaticArray.h"
 #include "Core/Containers/Array.h"
 #include "shaders.h"
 
 class GeomPool {
 public:
-    /// initialize the geom pool
-    void Setup(const Oryol::GfxSetup& gfxSetup);
+    /// initialize the geom pool, optionally with 32-bit indices and large geoms
+    void Setup(const Oryol::GfxSetup& gfxSetup, bool index32);
     /// discard the geom pool
     void Discard();
 
-    /// alloc a new geom, return geom index
-    int Alloc();
-    /// free a geom
+    /// max number of quads a single geom can hold
+    int MaxNumQuads() const;
+    /// return true if numQuads fit into one free geom or a chain of free regular geoms
+    bool CanAlloc(int numQuads) const;
+    /// max number of quads the next Alloc can take (a regular geom's size if no large geom is free)
+    int MaxAllocQuads() const;
+    /// alloc a new geom big enough for numQuads (at most MaxAllocQuads()), return geom index
+    int Alloc(int numQuads);
+    /// free a geom and all geoms chained to it
     void Free(int index);
     /// free all geoms
     void FreeAll();
 
+    bool Index32 = false;
     Oryol::Id IndexMesh;
     Oryol::Id Pipeline;
     struct Geom {
         Oryol::Id Mesh;
         int NumQuads = 0;
+        int Next = Oryol::InvalidIndex;     // next geom of the same chunk
+        glm::dvec3 Translate;               // world space, VSParams.Translate is relative to the camera origin
         Oryol::Shader::VSParams VSParams;
     };
-    static const int NumGeoms = 700;
-    Oryol::StaticArray<Geom, NumGeoms> Geoms;
+    /// number of geoms (set before Setup)
+    int NumGeoms = 700;
+    static const int NumLargeGeoms = 32;
+    // large geoms are at the end, only created in 32-bit index mode,
+    // when all are in use dense chunks are split over regular geoms
+    Oryol::Array<Geom> Geoms;
     Oryol::Array<int> freeGeoms;
+    Oryol::Array<int> freeLargeGeoms;
+    // estimated GPU memory of the meshes
+    int64_t gpuBytes = 0;
+    int64_t cpuBytes = 0;
 };
 
 //------------------------------------------------------------------------------
 inline int
-GeomPool::Alloc() {
-    o_assert(!this->freeGeoms.Empty());
-    int index = this->freeGeoms.PopBack();
+GeomPool::MaxNumQuads() const {
+    return this->Index32 ? Config::GeomLargeMaxNumQuads : Config::GeomMaxNumQuads;
+}
+
+//------------------------------------------------------------------------------
+inline bool
+GeomPool::CanAlloc(int numQuads) const {
+    if (numQuads <= Config::GeomMaxNumQuads) {
+        return !this->freeGeoms.Empty() || !this->freeLargeGeoms.Empty();
+    }
+    else if (!this->freeLargeGeoms.Empty()) {
+        return true;
+    }
+    else {
+        const int numGeoms = (numQuads + Config::GeomMaxNumQuads - 1) / Config::GeomMaxNumQuads;
+        return numGeoms <= this->freeGeoms.Size();
+    }
+}
+
+//------------------------------------------------------------------------------
+inline int
+GeomPool::MaxAllocQuads() const {
+    return this->freeLargeGeoms.Empty() ? Config::GeomMaxNumQuads : Config::GeomLargeMaxNumQuads;
+}
+
+//------------------------------------------------------------------------------
+inline int
+GeomPool::Alloc(int numQuads) {
+    o_assert_dbg(numQuads <= this->MaxAllocQuads());
+    o_assert(this->CanAlloc(numQuads));
+    int index;
+    if ((numQuads <= Config::GeomMaxNumQuads) && !this->freeGeoms.Empty()) {
+        index = this->freeGeoms.PopBack();
+    }
+    else {
+        index = this->freeLargeGeoms.PopBack();
+    }
     o_assert(Oryol::InvalidIndex != index);
+    this->Geoms[index].Next = Oryol::InvalidIndex;
     return index;
 }
 
@@ -49,5 +101,13 @@ GeomPool::Alloc() {
 inline void
 GeomPool::Free(int index) {
     o_assert_dbg(Oryol::InvalidIndex != index);
-    this->freeGeoms.Add(index);
+    while (Oryol::InvalidIndex != index) {
+        if (index < this->NumGeoms) {
+            this->freeGeoms.Add(index);
+        }
+        else {
+            this->freeLargeGeoms.Add(index);
+        }
+        index = this->Geoms[index].Next;
+    }
 }
@@ -0,0 +1,32 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class HeightField
+    @brief a chunk of voxel columns described by their height in a 2D array
+
+    Each column is solid from z=0 up to (but not including) its height,
+    the block type of a voxel is its z coordinate (clamped to 1). This
+    is the same data that GenSimplex writes into a Volume, but
+    without the 3D array.
+*/
+#include "Core/Types.h"
+
+struct HeightField {
+    // start pointer to column heights, x-major like Volume::Blocks
+    uint8_t* Heights = nullptr;
+
+    int ArraySizeX = 0;
+    int ArraySizeY = 0;
+
+    int OffsetX = 0;
+    int OffsetY = 0;
+    int OffsetZ = 0;
+
+    int SizeX = 0;
+    int SizeY = 0;
+    int SizeZ = 0;
+
+    // max height deviation from the next finer level's voxelization
+    // (exact from level 4 up, a sampled estimate on the finer levels)
+    float GeomError = 0.0f;
+};
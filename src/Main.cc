@@ -6,18 +6,30 @@
 #include "Gfx/Gfx.h"
 #include "Input/Input.h"
 #include "Dbg/Dbg.h"
+#include "Core/Assertion.h"
+#include "Core/Log.h"
 #include "Core/Time/Clock.h"
 #include "shaders.h"
 #include "GeomPool.h"
 #include "GeomMesher.h"
-#include "VoxelGenerator.h"
+#include "ChunkSource.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "MemTrack.h"
+#include "AllocCount.h"
 #include "VisTree.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "Settings.h"
 #include "glm/gtc/matrix_transform.hpp"
+#include <cstdio>
 
 using namespace Oryol;
 
-const int MaxChunksGeneratedPerFrame = 1;
+// the camera origin is moved when the camera gets this far away from it
+const float MaxOriginDist = 1024.0f;
+// memory cap of the compressed chunk store
+const int ChunkStoreMemory = 16 * 1024 * 1024;
 
 class VoxelTest : public App {
 public:
@@ -26,29 +38,78 @@ public:
     AppState::Code OnCleanup();
 
     void init_blocks(int frameIndex);
-    int bake_geom(const GeomMesher::Result& meshResult);
+    int bake_geom(const GeomMesher::Result& meshResult, int firstQuad, int numQuads, const glm::dvec3& translate);
     void handle_input();
+    void apply_actions(uint8_t actions);
+    void edit(uint8_t blockType);
+    void setup_metrics();
+    void update_metrics(int numDraws, int numQuads);
 
     int frameIndex = 0;
+    int64_t frameAllocs = 0;
     int lastFrameIndex = -1;
+    bool index32 = false;
+    Duration drawSubmitTime;
+    // frames until an edit was visible (stale draw nodes gone)
+    int editFrameIndex = -1;
+    TimePoint editTime;
+    int editLatencyFrames = 0;
+    Duration editLatency;
     glm::vec3 lightDir;
     ClearState clearState;
 
+    Settings settings;
     Camera camera;
+    CameraPath cameraPath;
+    bool recording = false;
+    bool replaying = false;
+    bool quitRequested = false;
+    TimePoint replayStart;
     GeomPool geomPool;
     GeomMesher geomMesher;
-    VoxelGenerator voxelGenerator;
+    ChunkSource chunkSource;
     VisTree visTree;
+
+    Metrics metrics;
+    struct {
+        int drawCalls, drawTris, drawSubmit;
+        int frameAllocs;
+        int geomsUsed;
+        int nodesUsed, nodesPeak, nodesMemory, nodesVisited, nodesReused, nodesReuseRate, nodesSplits, nodesMerges;
+        int occluders, occludedNodes, occlusionTime;
+        int traverseTime;
+        int jobsPending, jobsDone, jobsEmpty, jobsFailed, jobsEmptyRatio, jobsRemesh, jobTime, jobGeoms;
+        int jobQuads[VisTree::MaxNumLevels + 1];
+        int edits, editLatencyFrames, editLatency;
+        int memCPU, memCPUPeak, memGPU;
+        int memTags[MemTrack::NumTags];
+        int storeChunks, storeMemory, storeRawMemory, storeHits, storeMisses, storeEvictions, storeHitRate;
+    } metric;
 };
 OryolMain(VoxelTest);
 
 //------------------------------------------------------------------------------
 AppState::Code
 VoxelTest::OnInit() {
+    // -config file loads the tuning knobs, -<knob> value overrides
+    // single knobs (e.g. -tau 10 -geoms 1000, see Settings.h)
+    if (OryolArgs.HasArg("-config")) {
+        this->settings.Load(OryolArgs.GetString("-config").AsCStr());
+    }
+    for (int i = 0; i < Settings::NumKnobs; i++) {
+        char argName[32];
+        snprintf(argName, sizeof(argName), "-%s", Settings::Name(i));
+        if (OryolArgs.HasArg(argName)) {
+            this->settings.Set(Settings::Name(i), OryolArgs.GetString(argName).AsCStr());
+        }
+    }
+
     this->clearState = ClearState::ClearAll(glm::vec4(0.2f, 0.2f, 0.5f, 1.0f), 1.0f, 0);
     auto gfxSetup = GfxSetup::WindowMSAA4(800, 600, "Oryol Voxel Test");
     gfxSetup.SetPoolSize(GfxResourceType::Pipeline, 1024);
-    gfxSetup.SetPoolSize(GfxResourceType::Mesh, 1024);
+    // room for the geom meshes, the index mesh and the debug text meshes
+    const int numMeshes = this->settings.NumGeoms + GeomPool::NumLargeGeoms + 64;
+    gfxSetup.SetPoolSize(GfxResourceType::Mesh, numMeshes > 1024 ? numMeshes : 1024);
     gfxSetup.ClearHint = this->clearState;
     Gfx::Setup(gfxSetup);
     Input::Setup();
@@ -65,52 +126,85 @@ VoxelTest::OnInit() {
         return PointerLockMode::DontCare;
     });
     Dbg::Setup();
+    // -trace path writes the scoped timers as Chrome trace JSON on exit
+    Trace::Setup();
+    // -checkerboard replaces the terrain with a worst-case 3D checkerboard
+    this->chunkSource.Checkerboard = OryolArgs.HasArg("-checkerboard");
+    // -index32 enables 32-bit indices and large geoms, chunks over GeomMaxNumQuads
+    // need fewer draws while large geoms are free (see voxelsim -compareindex)
+    this->index32 = OryolArgs.HasArg("-index32");
 
     const float fbWidth = (const float) Gfx::DisplayAttrs().FramebufferWidth;
     const float fbHeight = (const float) Gfx::DisplayAttrs().FramebufferHeight;
-    this->camera.Setup(glm::vec3(4096, 128, 4096), glm::radians(45.0f), fbWidth, fbHeight, 0.1f, 10000.0f);
+    this->camera.Setup(glm::dvec3(4096, 128, 4096), glm::radians(45.0f), fbWidth, fbHeight, 0.1f, 10000.0f);
     this->lightDir = glm::normalize(glm::vec3(0.5f, 1.0f, 0.25f));
 
-    this->geomPool.Setup(gfxSetup);
-    this->geomMesher.Setup();
+    this->geomPool.NumGeoms = this->settings.NumGeoms;
+    this->geomPool.Setup(gfxSetup, this->index32);
+    // -nocoherence re-evaluates the whole VisTree every frame, -validatecoherence checks reused subtrees
+    this->visTree.TemporalCoherence = !OryolArgs.HasArg("-nocoherence");
+    this->visTree.ValidateCoherence = OryolArgs.HasArg("-validatecoherence");
+    // -noocclusion disables CPU occlusion culling against the terrain
+    this->visTree.OcclusionCulling = !OryolArgs.HasArg("-noocclusion");
+    // -nogeomerror uses the old 1<<lvl geometric error instead of the measured one
+    this->visTree.UseGeomError = !OryolArgs.HasArg("-nogeomerror");
+    this->geomMesher.Setup(this->geomPool.MaxNumQuads());
+    this->chunkSource.Setup(ChunkStoreMemory, this->settings.ChunkSize);
     // use a fixed display width, otherwise the geom pool could
     // run out of items at high resolutions
-    const float displayWidth = 800;
-    this->visTree.Setup(displayWidth, glm::radians(45.0f));
+    this->visTree.MaxNumNodes = this->settings.MaxNumNodes;
+    this->visTree.LodTau = this->settings.LodTau;
+    this->visTree.ChunkSize = this->settings.ChunkSize;
+    this->visTree.Setup(this->settings.DisplayWidth, glm::radians(45.0f));
+    // -metrics file.csv|file.jsonl logs the metrics every -metricsinterval frames
+    this->setup_metrics();
+    if (OryolArgs.HasArg("-metrics")) {
+        this->metrics.OpenLog(OryolArgs.GetString("-metrics").AsCStr());
+    }
+    // -record path records the camera path and edits, -replay path replays
+    // a recorded path (one recorded frame per frame) and quits at its end
+    if (OryolArgs.HasArg("-replay")) {
+        this->replaying = this->cameraPath.Load(OryolArgs.GetString("-replay").AsCStr());
+        this->replayStart = Clock::Now();
+    }
+    else if (OryolArgs.HasArg("-record")) {
+        this->cameraPath.StartRecording();
+        this->recording = true;
+    }
 
     return App::OnInit();
 }
 
 //------------------------------------------------------------------------------
 int
-VoxelTest::bake_geom(const GeomMesher::Result& meshResult) {
-    if (meshResult.NumQuads > 0) {
-        int geomIndex = this->geomPool.Alloc();
-        auto& geom = this->geomPool.Geoms[geomIndex];
-        Gfx::UpdateVertices(geom.Mesh, meshResult.Vertices, meshResult.NumBytes);
-        geom.NumQuads = meshResult.NumQuads;
-        geom.VSParams.Model = glm::mat4();
-        geom.VSParams.LightDir = this->lightDir;
-        geom.VSParams.Scale = meshResult.Scale;
-        geom.VSParams.Translate = meshResult.Translate;
-        geom.VSParams.TexTranslate = meshResult.TexTranslate;
-        return geomIndex;
-    }
-    else {
-        return VisNode::EmptyGeom;
-    }
+VoxelTest::bake_geom(const GeomMesher::Result& meshResult, int firstQuad, int numQuads, const glm::dvec3& translate) {
+    TRACE_SCOPE("VoxelTest::bake_geom");
+    int geomIndex = this->geomPool.Alloc(numQuads);
+    auto& geom = this->geomPool.Geoms[geomIndex];
+    const int quadSize = meshResult.NumBytes / meshResult.NumQuads;
+    Gfx::UpdateVertices(geom.Mesh, (const uint8_t*)meshResult.Vertices + firstQuad * quadSize, numQuads * quadSize);
+    geom.NumQuads = numQuads;
+    geom.VSParams.Model = glm::mat4();
+    geom.VSParams.LightDir = this->lightDir;
+    geom.VSParams.Scale = meshResult.Scale;
+    geom.Translate = translate;
+    geom.VSParams.TexTranslate = meshResult.TexTranslate;
+    return geomIndex;
 }
 
 //------------------------------------------------------------------------------
 AppState::Code
 VoxelTest::OnRunning() {
+    TRACE_SCOPE("VoxelTest::OnRunning");
     this->frameIndex++;
     this->handle_input();
 
     Gfx::ApplyDefaultRenderTarget(this->clearState);
 
     // traverse the vis-tree
+    TimePoint traverseStart = Clock::Now();
     this->visTree.Traverse(this->camera);
+    this->metrics.Sample(this->metric.traverseTime, Clock::Since(traverseStart).AsMilliSeconds());
     // free any geoms to be freed
     while (!this->visTree.freeGeoms.Empty()) {
         int geom = this->visTree.freeGeoms.PopBack();
@@ -119,77 +213,142 @@ VoxelTest::OnRunning() {
     // init new geoms
     if (!this->visTree.geomGenJobs.Empty()) {
         int numProcessedJobs = 0;
-        while ((numProcessedJobs < MaxChunksGeneratedPerFrame) && !this->visTree.geomGenJobs.Empty()) {
+        while ((numProcessedJobs < this->settings.JobsPerFrame) && !this->visTree.geomGenJobs.Empty()) {
+            TRACE_SCOPE("geom job");
+            TimePoint jobStart = Clock::Now();
             numProcessedJobs++;
-            int16_t     geoms[VisNode::NumGeoms];
+            // a chunk can fill any number of geoms, these are chained
+            // together through GeomPool::Geom::Next
+            int firstGeom = VisNode::EmptyGeom;
+            int lastGeom = InvalidIndex;
             int numGeoms = 0;
+            int numQuads = 0;
             VisTree::GeomGenJob job = this->visTree.geomGenJobs.PopBack();
-            Volume vol = this->voxelGenerator.GenSimplex(job.Bounds);
             GeomMesher::Result meshResult;
-            this->geomMesher.Start();
-            this->geomMesher.StartVolume(vol);
+            this->chunkSource.Start(job, this->visTree, this->geomMesher);
             do {
                 meshResult = this->geomMesher.Meshify();
                 meshResult.Scale = job.Scale;
-                meshResult.Translate = job.Translate;
-                if (meshResult.BufferFull) {
-                    int geom = this->bake_geom(meshResult);
-                    o_assert(numGeoms < VisNode::NumGeoms);
-                    geoms[numGeoms++] = geom;
+                if (meshResult.NumQuads > 0) {
+                    if (!this->geomPool.CanAlloc(meshResult.NumQuads)) {
+                        // out of geoms, drop the chunk, the vistree
+                        // will request it again once geoms are available
+                        if (firstGeom >= 0) {
+                            this->geomPool.Free(firstGeom);
+                        }
+                        firstGeom = VisNode::InvalidGeom;
+                        break;
+                    }
+                    // in 32-bit mode a dense chunk is split over regular
+                    // geoms when all large geoms are in use
+                    for (int quad = 0; quad < meshResult.NumQuads; ) {
+                        const int maxQuads = this->geomPool.MaxAllocQuads();
+                        const int num = (meshResult.NumQuads - quad) < maxQuads ? (meshResult.NumQuads - quad) : maxQuads;
+                        int geom = this->bake_geom(meshResult, quad, num, job.Translate);
+                        numGeoms++;
+                        quad += num;
+                        if (InvalidIndex == lastGeom) {
+                            firstGeom = geom;
+                        }
+                        else {
+                            this->geomPool.Geoms[lastGeom].Next = geom;
+                        }
+                        lastGeom = geom;
+                    }
+                    numQuads += meshResult.NumQuads;
                 }
             }
             while (!meshResult.VolumeDone);
-            int geom = this->bake_geom(meshResult);
-            o_assert(numGeoms < VisNode::NumGeoms);
-            geoms[numGeoms++] = geom;
-            this->visTree.ApplyGeoms(job.NodeIndex, geoms, numGeoms);
+            this->visTree.ApplyGeoms(job.Node, firstGeom);
+            this->metrics.Inc(this->metric.jobsDone);
+            if (VisNode::EmptyGeom == firstGeom) {
+                this->metrics.Inc(this->metric.jobsEmpty);
+            }
+            else if (VisNode::InvalidGeom == firstGeom) {
+                this->metrics.Inc(this->metric.jobsFailed);
+            }
+            else {
+                this->metrics.Sample(this->metric.jobGeoms, numGeoms);
+                o_assert_dbg((job.Level >= 0) && (job.Level <= this->visTree.NumLevels()));
+                this->metrics.Sample(this->metric.jobQuads[job.Level], numQuads);
+            }
+            this->metrics.Sample(this->metric.jobTime, Clock::Since(jobStart).AsMilliSeconds());
         }
     }
 
+    if ((this->editFrameIndex >= 0) && (0 == this->visTree.NumStaleDrawNodes())) {
+        this->editLatencyFrames = this->frameIndex - this->editFrameIndex;
+        this->editLatency = Clock::Since(this->editTime);
+        this->editFrameIndex = -1;
+    }
+
     // render visible geoms
     const int numDrawNodes = this->visTree.drawNodes.Size();
     int numQuads = 0;
     int numGeoms = 0;
-    DrawState drawState;
-    drawState.Mesh[0] = this->geomPool.IndexMesh;
-    drawState.Pipeline = this->geomPool.Pipeline;
-    for (int i = 0; i < numDrawNodes; i++) {
-        const VisNode& node = this->visTree.NodeAt(this->visTree.drawNodes[i]);
-        for (int geomIndex = 0; geomIndex < VisNode::NumGeoms; geomIndex++) {
-            if (node.geoms[geomIndex] >= 0) {
-                auto& geom = this->geomPool.Geoms[node.geoms[geomIndex]];
+    {
+        TRACE_SCOPE("draw submit");
+        TimePoint drawStart = Clock::Now();
+        DrawState drawState;
+        drawState.Mesh[0] = this->geomPool.IndexMesh;
+        drawState.Pipeline = this->geomPool.Pipeline;
+        // geoms are drawn relative to the camera origin, note that
+        // the geom translation is in voxel space (z is up)
+        const glm::dvec3& origin = this->camera.Origin;
+        for (int i = 0; i < numDrawNodes; i++) {
+            const VisNode& node = this->visTree.NodeAt(this->visTree.drawNodes[i]);
+            int geomIndex = node.geom;
+            while (geomIndex >= 0) {
+                auto& geom = this->geomPool.Geoms[geomIndex];
                 drawState.Mesh[1] = geom.Mesh;
                 geom.VSParams.ModelViewProjection = this->camera.ViewProj;
+                geom.VSParams.Translate = glm::vec3(geom.Translate.x - origin.x, geom.Translate.y - origin.z, geom.Translate.z - origin.y);
                 Gfx::ApplyDrawState(drawState);
                 Gfx::ApplyUniformBlock(geom.VSParams);
                 Gfx::Draw(PrimitiveGroup(0, geom.NumQuads*6));
                 numQuads += geom.NumQuads;
                 numGeoms++;
+                geomIndex = geom.Next;
             }
         }
+        this->drawSubmitTime = Clock::Since(drawStart);
     }
+    this->update_metrics(numGeoms, numQuads);
     Dbg::PrintF("\n\r"
                 " Desktop:  LMB+Mouse or AWSD to move, RMB+Mouse to look around\n\r"
-                " Mobile:   touch+pan to fly\n\n\r"
-                " draws: %d\n\r"
-                " tris: %d\n\r"
-                " avail geoms: %d\n\r"
-                " avail nodes: %d\n\r"
-                " pending chunks: %d\n\r",
-                numGeoms, numQuads*2,
-                this->geomPool.freeGeoms.Size(),
-                this->visTree.freeNodes.Size(),
-                this->visTree.geomGenJobs.Size());
+                " Mobile:   touch+pan to fly\n\r"
+                " Q/E to dig/place voxels, T to write a trace, M to log memory\n\n\r"
+                " index mode: %s\n\r",
+                this->index32 ? "32-bit" : "16-bit");
+    char value[64];
+    for (int i = 0; i < this->metrics.Num(); i++) {
+        if (this->metrics.Overlay(i)) {
+            this->metrics.Format(i, value, sizeof(value));
+            Dbg::PrintF(" %s: %s\n\r", this->metrics.Name(i), value);
+        }
+    }
     Dbg::DrawTextBuffer();
-    Gfx::CommitFrame();
+    {
+        TRACE_SCOPE("Gfx::CommitFrame");
+        Gfx::CommitFrame();
+    }
 
-    return Gfx::QuitRequested() ? AppState::Cleanup : AppState::Running;
+    return (Gfx::QuitRequested() || this->quitRequested) ? AppState::Cleanup : AppState::Running;
 }
 
 //------------------------------------------------------------------------------
 AppState::Code
 VoxelTest::OnCleanup() {
+    if (this->recording) {
+        this->cameraPath.Save(OryolArgs.GetString("-record").AsCStr());
+    }
+    if (OryolArgs.HasArg("-trace")) {
+        Trace::Write(OryolArgs.GetString("-trace").AsCStr());
+    }
+    Trace::Discard();
+    this->metrics.Discard();
     this->visTree.Discard();
+    this->chunkSource.Discard();
     this->geomMesher.Discard();
     this->geomPool.Discard();
     Dbg::Discard();
@@ -198,10 +357,134 @@ VoxelTest::OnCleanup() {
     return App::OnCleanup();
 }
 
+//------------------------------------------------------------------------------
+void
+VoxelTest::setup_metrics() {
+    Metrics& m = this->metrics;
+    m.Setup(OryolArgs.HasArg("-metricsinterval") ? OryolArgs.GetInt("-metricsinterval") : 60);
+    this->metric.drawCalls = m.Add("draw.calls", Metrics::Gauge);
+    this->metric.drawTris = m.Add("draw.tris", Metrics::Gauge);
+    this->metric.drawSubmit = m.Add("draw.submit_ms", Metrics::Gauge);
+    // heap allocations of the main thread per frame (including Gfx)
+    this->metric.frameAllocs = m.Add("frame.allocs", Metrics::Histogram);
+    this->metric.geomsUsed = m.Add("geoms.used", Metrics::Gauge);
+    this->metric.nodesUsed = m.Add("nodes.used", Metrics::Gauge);
+    this->metric.nodesPeak = m.Add("nodes.peak", Metrics::Gauge);
+    this->metric.nodesMemory = m.Add("nodes.kb", Metrics::Gauge);
+    this->metric.nodesVisited = m.Add("nodes.visited", Metrics::Gauge);
+    this->metric.nodesReused = m.Add("nodes.reused", Metrics::Gauge);
+    this->metric.nodesReuseRate = m.Add("nodes.reuse_rate", Metrics::Gauge, false);
+    this->metric.nodesSplits = m.Add("nodes.splits", Metrics::Counter);
+    this->metric.nodesMerges = m.Add("nodes.merges", Metrics::Counter);
+    this->metric.occluders = m.Add("occlusion.occluders", Metrics::Gauge);
+    this->metric.occludedNodes = m.Add("occlusion.nodes", Metrics::Gauge);
+    this->metric.occlusionTime = m.Add("occlusion.ms", Metrics::Gauge);
+    this->metric.traverseTime = m.Add("traverse.ms", Metrics::Histogram);
+    this->metric.jobsPending = m.Add("jobs.pending", Metrics::Gauge);
+    this->metric.jobsDone = m.Add("jobs.done", Metrics::Counter);
+    this->metric.jobsEmpty = m.Add("jobs.empty", Metrics::Counter, false);
+    this->metric.jobsFailed = m.Add("jobs.failed", Metrics::Counter);
+    this->metric.jobsEmptyRatio = m.Add("jobs.empty_ratio", Metrics::Gauge);
+    this->metric.jobsRemesh = m.Add("jobs.remesh", Metrics::Counter);
+    this->metric.jobTime = m.Add("jobs.ms", Metrics::Histogram);
+    this->metric.jobGeoms = m.Add("jobs.geoms", Metrics::Histogram);
+    char name[32];
+    // root cell jobs are queued at level NumLevels()
+    for (int lvl = 0; lvl <= this->visTree.NumLevels(); lvl++) {
+        snprintf(name, sizeof(name), "jobs.quads.lvl%d", lvl);
+        this->metric.jobQuads[lvl] = m.Add(name, Metrics::Histogram, false);
+    }
+    this->metric.edits = m.Add("edits.num", Metrics::Gauge);
+    this->metric.editLatencyFrames = m.Add("edits.latency_frames", Metrics::Gauge);
+    this->metric.editLatency = m.Add("edits.latency_ms", Metrics::Gauge);
+    this->metric.memCPU = m.Add("mem.cpu_kb", Metrics::Gauge);
+    this->metric.memCPUPeak = m.Add("mem.cpu_peak_kb", Metrics::Gauge);
+    this->metric.memGPU = m.Add("mem.gpu_kb", Metrics::Gauge);
+    for (int i = 0; i < MemTrack::NumTags; i++) {
+        snprintf(name, sizeof(name), "mem.%s.cpu_kb", MemTrack::Name(MemTrack::Tag(i)));
+        this->metric.memTags[i] = m.Add(name, Metrics::Gauge, false);
+    }
+    this->metric.storeChunks = m.Add("store.chunks", Metrics::Gauge);
+    this->metric.storeMemory = m.Add("store.kb", Metrics::Gauge);
+    this->metric.storeRawMemory = m.Add("store.raw_kb", Metrics::Gauge, false);
+    this->metric.storeHits = m.Add("store.hits", Metrics::Counter, false);
+    this->metric.storeMisses = m.Add("store.misses", Metrics::Counter, false);
+    this->metric.storeEvictions = m.Add("store.evictions", Metrics::Counter, false);
+    this->metric.storeHitRate = m.Add("store.hit_rate", Metrics::Gauge);
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelTest::update_metrics(int numDraws, int numQuads) {
+    // the gauges, and the counters of running totals kept by the
+    // subsystems, the histograms and job counters are fed directly
+    Metrics& m = this->metrics;
+    const VisTree& vt = this->visTree;
+    const ChunkStore& store = this->chunkSource.Store;
+    m.Set(this->metric.drawCalls, numDraws);
+    m.Set(this->metric.drawTris, numQuads * 2);
+    m.Set(this->metric.drawSubmit, this->drawSubmitTime.AsMilliSeconds());
+    const int64_t allocs = AllocCount::Thread();
+    m.Sample(this->metric.frameAllocs, double(allocs - this->frameAllocs));
+    this->frameAllocs = allocs;
+    m.Set(this->metric.geomsUsed, this->geomPool.NumGeoms + (this->index32 ? GeomPool::NumLargeGeoms : 0) -
+        (this->geomPool.freeGeoms.Size() + this->geomPool.freeLargeGeoms.Size()));
+    m.Set(this->metric.nodesUsed, vt.NumNodes() - vt.NumFreeNodes());
+    m.Set(this->metric.nodesPeak, vt.MaxUsedNodes);
+    m.Set(this->metric.nodesMemory, vt.NodeMemory() / 1024);
+    m.Set(this->metric.nodesVisited, vt.NumVisitedNodes);
+    m.Set(this->metric.nodesReused, vt.NumReusedNodes);
+    const int numEvaluated = vt.NumVisitedNodes + vt.NumReusedNodes;
+    m.Set(this->metric.nodesReuseRate, numEvaluated > 0 ? double(vt.NumReusedNodes) / numEvaluated : 0.0);
+    m.Set(this->metric.nodesSplits, vt.NumSplits);
+    m.Set(this->metric.nodesMerges, vt.NumMerges);
+    m.Set(this->metric.occluders, vt.NumOccluders);
+    m.Set(this->metric.occludedNodes, vt.NumOccludedNodes);
+    m.Set(this->metric.occlusionTime, vt.OcclusionTime.AsMilliSeconds());
+    m.Set(this->metric.jobsPending, vt.geomGenJobs.Size());
+    const double numJobs = m.Value(this->metric.jobsDone);
+    m.Set(this->metric.jobsEmptyRatio, numJobs > 0.0 ? m.Value(this->metric.jobsEmpty) / numJobs : 0.0);
+    m.Set(this->metric.jobsRemesh, vt.NumRemeshJobs);
+    m.Set(this->metric.edits, this->chunkSource.Edits.NumEdits());
+    m.Set(this->metric.editLatencyFrames, this->editLatencyFrames);
+    m.Set(this->metric.editLatency, this->editLatency.AsMilliSeconds());
+    m.Set(this->metric.memCPU, MemTrack::Total(MemTrack::CPU) / 1024);
+    m.Set(this->metric.memCPUPeak, MemTrack::TotalPeak(MemTrack::CPU) / 1024);
+    m.Set(this->metric.memGPU, MemTrack::Total(MemTrack::GPU) / 1024);
+    for (int i = 0; i < MemTrack::NumTags; i++) {
+        m.Set(this->metric.memTags[i], MemTrack::Current(MemTrack::Tag(i), MemTrack::CPU) / 1024);
+    }
+    m.Set(this->metric.storeChunks, store.NumChunks());
+    m.Set(this->metric.storeMemory, store.CompressedMemory() / 1024);
+    m.Set(this->metric.storeRawMemory, store.RawMemory() / 1024);
+    m.Set(this->metric.storeHits, store.NumHits);
+    m.Set(this->metric.storeMisses, store.NumMisses);
+    m.Set(this->metric.storeEvictions, store.NumEvictions);
+    const int numLookups = store.NumHits + store.NumMisses;
+    m.Set(this->metric.storeHitRate, numLookups > 0 ? double(store.NumHits) / numLookups : 0.0);
+    m.EndFrame();
+}
+
 //------------------------------------------------------------------------------
 void
 VoxelTest::handle_input() {
+    if (this->replaying) {
+        // the recorded frames replace the input, one recorded frame per frame
+        uint8_t actions = 0;
+        if (!this->cameraPath.Next(this->camera, actions)) {
+            Log::Info("replay done: %d frames, %.3f ms avg frame time\n",
+                this->cameraPath.NumReplayedFrames(),
+                this->cameraPath.NumReplayedFrames() > 0 ?
+                Clock::Since(this->replayStart).AsMilliSeconds() / this->cameraPath.NumReplayedFrames() : 0.0);
+            this->replaying = false;
+            this->quitRequested = true;
+            return;
+        }
+        this->apply_actions(actions);
+        return;
+    }
     glm::vec3 move;
+    uint8_t actions = 0;
     glm::vec2 rot;
     const float vel = 0.75f;
     if (Input::KeyboardAttached()) {
@@ -217,6 +500,18 @@ VoxelTest::handle_input() {
         if (Input::KeyPressed(Key::D) || Input::KeyPressed(Key::Right)) {
             move.x += vel;
         }
+        if (Input::KeyDown(Key::Q)) {
+            actions |= CameraPath::Dig;
+        }
+        if (Input::KeyDown(Key::E)) {
+            actions |= CameraPath::Place;
+        }
+        if (Input::KeyDown(Key::T)) {
+            Trace::Write("voxeltest-trace.json");
+        }
+        if (Input::KeyDown(Key::M)) {
+            MemTrack::Dump();
+        }
     }
     if (Input::MouseAttached) {
         if (Input::MouseButtonPressed(MouseButton::Left)) {
@@ -233,4 +528,31 @@ VoxelTest::handle_input() {
         }
     }
     this->camera.MoveRotate(move, rot);
+    this->camera.Rebase(MaxOriginDist);
+    if (this->recording) {
+        this->cameraPath.Record(this->camera, actions);
+    }
+    this->apply_actions(actions);
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelTest::apply_actions(uint8_t actions) {
+    if (actions & CameraPath::Dig) {
+        this->edit(0);
+    }
+    if (actions & CameraPath::Place) {
+        this->edit(Config::ChunkSizeZ);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelTest::edit(uint8_t blockType) {
+    // apply a sphere brush in front of the camera (blockType 0 digs)
+    this->visTree.MarkDirty(this->chunkSource.Brush(this->camera, blockType));
+    if (this->editFrameIndex < 0) {
+        this->editFrameIndex = this->frameIndex;
+        this->editTime = Clock::Now();
+    }
 }
@@ -0,0 +1,120 @@
+//------------------------------------------------------------------------------
+//  MemTrack.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "MemTrack.h"
+#include "Core/Assertion.h"
+#include "Core/Log.h"
+#include <atomic>
+
+using namespace Oryol;
+
+static std::atomic<int64_t> current[MemTrack::NumTags][MemTrack::NumKinds];
+static std::atomic<int64_t> peak[MemTrack::NumTags][MemTrack::NumKinds];
+static std::atomic<int64_t> total[MemTrack::NumKinds];
+static std::atomic<int64_t> totalPeak[MemTrack::NumKinds];
+
+//------------------------------------------------------------------------------
+static void
+updatePeak(std::atomic<int64_t>& p, int64_t val) {
+    int64_t cur = p.load(std::memory_order_relaxed);
+    while ((val > cur) && !p.compare_exchange_weak(cur, val, std::memory_order_relaxed)) { }
+}
+
+//------------------------------------------------------------------------------
+void
+MemTrack::Alloc(Tag tag, Kind kind, int64_t bytes) {
+    o_assert_dbg((tag < NumTags) && (kind < NumKinds));
+    const int64_t cur = current[tag][kind].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    updatePeak(peak[tag][kind], cur);
+    const int64_t tot = total[kind].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    updatePeak(totalPeak[kind], tot);
+}
+
+//------------------------------------------------------------------------------
+void
+MemTrack::Free(Tag tag, Kind kind, int64_t bytes) {
+    o_assert_dbg((tag < NumTags) && (kind < NumKinds));
+    current[tag][kind].fetch_sub(bytes, std::memory_order_relaxed);
+    total[kind].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+void
+MemTrack::Resize(Tag tag, Kind kind, int64_t& reportedBytes, int64_t bytes) {
+    if (bytes > reportedBytes) {
+        Alloc(tag, kind, bytes - reportedBytes);
+    }
+    else if (bytes < reportedBytes) {
+        Free(tag, kind, reportedBytes - bytes);
+    }
+    reportedBytes = bytes;
+}
+
+//------------------------------------------------------------------------------
+int64_t
+MemTrack::Current(Tag tag, Kind kind) {
+    return current[tag][kind].load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+int64_t
+MemTrack::Peak(Tag tag, Kind kind) {
+    return peak[tag][kind].load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+int64_t
+MemTrack::Total(Kind kind) {
+    return total[kind].load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+int64_t
+MemTrack::TotalPeak(Kind kind) {
+    return totalPeak[kind].load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+void
+MemTrack::ResetPeaks() {
+    for (int kind = 0; kind < NumKinds; kind++) {
+        for (int tag = 0; tag < NumTags; tag++) {
+            peak[tag][kind] = current[tag][kind].load();
+        }
+        totalPeak[kind] = total[kind].load();
+    }
+}
+
+//------------------------------------------------------------------------------
+const char*
+MemTrack::Name(Tag tag) {
+    switch (tag) {
+        case Generator: return "generator";
+        case Mesher:    return "mesher";
+        case Edits:     return "edits";
+        case Store:     return "store";
+        case Nodes:     return "nodes";
+        case Jobs:      return "jobs";
+        case Traversal: return "traversal";
+        case Geoms:     return "geoms";
+        case Tracing:   return "trace";
+        case Stats:     return "metrics";
+        default:        return "invalid";
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+MemTrack::Dump() {
+    Log::Info("%-10s %10s %10s %10s %10s\n", "memory", "cpu KB", "cpu peak", "gpu KB", "gpu peak");
+    for (int i = 0; i < NumTags; i++) {
+        const Tag tag = Tag(i);
+        Log::Info("%-10s %10.1f %10.1f %10.1f %10.1f\n", Name(tag),
+            Current(tag, CPU) / 1024.0, Peak(tag, CPU) / 1024.0,
+            Current(tag, GPU) / 1024.0, Peak(tag, GPU) / 1024.0);
+    }
+    Log::Info("%-10s %10.1f %10.1f %10.1f %10.1f\n", "total",
+        Total(CPU) / 1024.0, TotalPeak(CPU) / 1024.0,
+        Total(GPU) / 1024.0, TotalPeak(GPU) / 1024.0);
+}
@@ -0,0 +1,63 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class MemTrack
+    @brief per-subsystem memory accounting with high-water marks
+
+    Subsystems report the memory they own under a tag, separately for
+    CPU memory and (estimated) GPU memory. Fixed buffers are reported
+    with Alloc() and Free() when they are created and destroyed, growing
+    containers report their capacity with Resize() when it may have
+    changed (the caller keeps the previously reported size, so several
+    instances can share a tag). Current and peak bytes can be queried
+    at any time, the counters are atomic so generation threads can
+    report too.
+*/
+#include "Core/Types.h"
+
+class MemTrack {
+public:
+    /// the subsystems
+    enum Tag {
+        Generator = 0,      // VoxelGenerator volumes
+        Mesher,             // GeomMesher vertex buffer
+        Edits,              // VoxelEdits
+        Store,              // ChunkStore compressed chunks and scratch buffers
+        Nodes,              // VisTree node arrays
+        Jobs,               // VisTree job queues and free geoms
+        Traversal,          // VisTree traversal scratch, draw lists, occlusion buffer
+        Geoms,              // GeomPool meshes and index buffer
+        Tracing,            // Trace ring buffers
+        Stats,              // Metrics registry
+
+        NumTags
+    };
+    enum Kind {
+        CPU = 0,
+        GPU,
+
+        NumKinds
+    };
+
+    /// report an allocation
+    static void Alloc(Tag tag, Kind kind, int64_t bytes);
+    /// report a deallocation
+    static void Free(Tag tag, Kind kind, int64_t bytes);
+    /// report a changed size, reportedBytes is the caller's previously reported size and is updated
+    static void Resize(Tag tag, Kind kind, int64_t& reportedBytes, int64_t bytes);
+
+    /// current bytes of a tag
+    static int64_t Current(Tag tag, Kind kind);
+    /// peak bytes of a tag
+    static int64_t Peak(Tag tag, Kind kind);
+    /// current bytes of all tags
+    static int64_t Total(Kind kind);
+    /// peak of the total bytes
+    static int64_t TotalPeak(Kind kind);
+    /// reset the peaks to the current values
+    static void ResetPeaks();
+    /// name of a tag
+    static const char* Name(Tag tag);
+    /// log a table of all tags
+    static void Dump();
+};
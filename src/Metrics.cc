@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+//  Metrics.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Metrics.h"
+#include "MemTrack.h"
+#include "Core/Assertion.h"
+#include "Core/Log.h"
+#include <cmath>
+#include <cstring>
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+void
+Metrics::Setup(int numFrames) {
+    o_assert(numFrames > 0);
+    this->interval = numFrames;
+    this->frameIndex = 0;
+    this->metrics.Reserve(64);
+    MemTrack::Resize(MemTrack::Stats, MemTrack::CPU, this->trackedBytes, this->metrics.Capacity() * sizeof(metric));
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::Discard() {
+    this->CloseLog();
+    this->metrics.Clear();
+    MemTrack::Resize(MemTrack::Stats, MemTrack::CPU, this->trackedBytes, 0);
+}
+
+//------------------------------------------------------------------------------
+int
+Metrics::Add(const char* name, Type type, bool overlay) {
+    metric m;
+    m.name = name;
+    m.type = type;
+    m.overlay = overlay;
+    memset(m.buckets, 0, sizeof(m.buckets));
+    this->metrics.Add(m);
+    MemTrack::Resize(MemTrack::Stats, MemTrack::CPU, this->trackedBytes, this->metrics.Capacity() * sizeof(metric));
+    return this->metrics.Size() - 1;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::Inc(int index, double num) {
+    o_assert_dbg(Counter == this->metrics[index].type);
+    this->metrics[index].value += num;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::Set(int index, double value) {
+    o_assert_dbg(Histogram != this->metrics[index].type);
+    this->metrics[index].value = value;
+}
+
+//------------------------------------------------------------------------------
+int
+Metrics::bucket(double value) {
+    // bucket 0 is for values below 2^MinLog2 (including 0)
+    const double l = log2(value) - MinLog2;
+    if (!(l >= 0.0)) {
+        return 0;
+    }
+    const int b = 1 + int(l * 4.0);
+    return b < NumBuckets ? b : NumBuckets - 1;
+}
+
+//------------------------------------------------------------------------------
+double
+Metrics::bucketValue(int b) {
+    return b > 0 ? exp2((b - 0.5) * 0.25 + MinLog2) : 0.0;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::Sample(int index, double value) {
+    metric& m = this->metrics[index];
+    o_assert_dbg(Histogram == m.type);
+    m.buckets[bucket(value)]++;
+    m.sum += value;
+    m.max = (0 == m.count) || (value > m.max) ? value : m.max;
+    m.count++;
+}
+
+//------------------------------------------------------------------------------
+double
+Metrics::percentile(const metric& m, double p) {
+    const int rank = int(ceil(p * m.count));
+    int num = 0;
+    for (int b = 0; b < NumBuckets; b++) {
+        num += m.buckets[b];
+        if (num >= rank) {
+            // the bucket's center, but never above the max sample
+            const double value = bucketValue(b);
+            return value < m.max ? value : m.max;
+        }
+    }
+    return m.max;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::finishInterval(metric& m) {
+    m.lastCount = m.count;
+    m.lastMean = m.count > 0 ? m.sum / m.count : 0.0;
+    m.lastP50 = m.count > 0 ? percentile(m, 0.5) : 0.0;
+    m.lastP90 = m.count > 0 ? percentile(m, 0.9) : 0.0;
+    m.lastMax = m.max;
+    m.count = 0;
+    m.sum = 0.0;
+    m.max = 0.0;
+    memset(m.buckets, 0, sizeof(m.buckets));
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::EndFrame() {
+    this->frameIndex++;
+    if (0 == (this->frameIndex % this->interval)) {
+        for (metric& m : this->metrics) {
+            if (Histogram == m.type) {
+                finishInterval(m);
+            }
+        }
+        if (this->log) {
+            this->writeLog();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Metrics::OpenLog(const char* path) {
+    this->CloseLog();
+    this->log = fopen(path, "w");
+    if (!this->log) {
+        Log::Warn("Metrics: failed to create '%s'\n", path);
+        return false;
+    }
+    const int len = int(strlen(path));
+    this->csv = (len > 4) && (0 == strcmp(path + len - 4, ".csv"));
+    this->numLogMetrics = -1;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::CloseLog() {
+    if (this->log) {
+        fclose(this->log);
+        this->log = nullptr;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::writeLog() {
+    if (this->csv) {
+        if (this->numLogMetrics < 0) {
+            // metrics registered later than the first row are not logged,
+            // the rows only have the columns of the header
+            this->numLogMetrics = this->metrics.Size();
+            fprintf(this->log, "frame");
+            for (const metric& m : this->metrics) {
+                if (Histogram == m.type) {
+                    const char* name = m.name.AsCStr();
+                    fprintf(this->log, ",%s.count,%s.mean,%s.p50,%s.p90,%s.max", name, name, name, name, name);
+                }
+                else {
+                    fprintf(this->log, ",%s", m.name.AsCStr());
+                }
+            }
+            fprintf(this->log, "\n");
+        }
+        fprintf(this->log, "%d", this->frameIndex);
+        for (int i = 0; i < this->numLogMetrics; i++) {
+            const metric& m = this->metrics[i];
+            if (Histogram == m.type) {
+                fprintf(this->log, ",%d,%g,%g,%g,%g", m.lastCount, m.lastMean, m.lastP50, m.lastP90, m.lastMax);
+            }
+            else {
+                fprintf(this->log, ",%g", m.value);
+            }
+        }
+        fprintf(this->log, "\n");
+    }
+    else {
+        fprintf(this->log, "{\"frame\":%d", this->frameIndex);
+        for (const metric& m : this->metrics) {
+            if (Histogram == m.type) {
+                fprintf(this->log, ",\"%s\":{\"count\":%d,\"mean\":%g,\"p50\":%g,\"p90\":%g,\"max\":%g}",
+                    m.name.AsCStr(), m.lastCount, m.lastMean, m.lastP50, m.lastP90, m.lastMax);
+            }
+            else {
+                fprintf(this->log, ",\"%s\":%g", m.name.AsCStr(), m.value);
+            }
+        }
+        fprintf(this->log, "}\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+Metrics::Num() const {
+    return this->metrics.Size();
+}
+
+//------------------------------------------------------------------------------
+const char*
+Metrics::Name(int index) const {
+    return this->metrics[index].name.AsCStr();
+}
+
+//------------------------------------------------------------------------------
+bool
+Metrics::Overlay(int index) const {
+    return this->metrics[index].overlay;
+}
+
+//------------------------------------------------------------------------------
+double
+Metrics::Value(int index) const {
+    const metric& m = this->metrics[index];
+    return Histogram == m.type ? m.lastMean : m.value;
+}
+
+//------------------------------------------------------------------------------
+void
+Metrics::Format(int index, char* buf, int bufSize) const {
+    const metric& m = this->metrics[index];
+    if (Histogram == m.type) {
+        snprintf(buf, bufSize, "%.3g avg, %.3g p50, %.3g p90, %.3g max (%d)",
+            m.lastMean, m.lastP50, m.lastP90, m.lastMax, m.lastCount);
+    }
+    else if (m.value == floor(m.value)) {
+        snprintf(buf, bufSize, "%.0f", m.value);
+    }
+    else {
+        snprintf(buf, bufSize, "%.3f", m.value);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Metrics
+    @brief registry of named counters, gauges and histograms
+
+    Counters are running totals, gauges hold the latest value, and
+    histograms collect samples per interval of N frames (count, mean,
+    median, 90th percentile and max of the last finished interval).
+    Histogram buckets are 4 per power of 2 from 2^-10 to 2^21, so
+    percentiles are within about 10% of the actual value.
+
+    At the end of each interval a row with all metrics is appended to
+    the log file if one is open: CSV if the file name ends in .csv,
+    otherwise JSON lines. CSV rows only have the metrics registered
+    before the first row (the header's columns).
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include "Core/String/String.h"
+#include <cstdio>
+
+class Metrics {
+public:
+    enum Type {
+        Counter,
+        Gauge,
+        Histogram,
+    };
+    /// setup with the interval in frames for histograms and the log
+    void Setup(int interval);
+    /// discard the registry (closes the log)
+    void Discard();
+
+    /// register a metric, return its index, overlay metrics are shown in the app's debug text
+    int Add(const char* name, Type type, bool overlay = true);
+    /// add to a counter
+    void Inc(int metric, double num = 1.0);
+    /// set a gauge, or a counter to a running total kept elsewhere
+    void Set(int metric, double value);
+    /// add a histogram sample
+    void Sample(int metric, double value);
+    /// call at the end of each frame, finishes an interval every N frames
+    void EndFrame();
+
+    /// open the log file, return false on error
+    bool OpenLog(const char* path);
+    /// close the log file
+    void CloseLog();
+
+    /// number of metrics
+    int Num() const;
+    /// get a metric's name
+    const char* Name(int metric) const;
+    /// return true if the metric is shown in the overlay
+    bool Overlay(int metric) const;
+    /// get a counter's total, a gauge's value, or the mean of a histogram's last interval
+    double Value(int metric) const;
+    /// format a metric's value for display
+    void Format(int metric, char* buf, int bufSize) const;
+
+    static const int NumBuckets = 128;
+    static const int MinLog2 = -10;
+    struct metric {
+        Oryol::String name;
+        Type type = Counter;
+        bool overlay = true;
+        double value = 0.0;
+        // histogram samples of the current interval
+        int count = 0;
+        double sum = 0.0;
+        double max = 0.0;
+        uint32_t buckets[NumBuckets];
+        // histogram results of the last finished interval
+        int lastCount = 0;
+        double lastMean = 0.0;
+        double lastP50 = 0.0;
+        double lastP90 = 0.0;
+        double lastMax = 0.0;
+    };
+    /// get the bucket of a histogram sample
+    static int bucket(double value);
+    /// get the geometric center of a bucket
+    static double bucketValue(int bucket);
+    /// get a percentile of the current interval's samples
+    static double percentile(const metric& m, double p);
+    /// finish the current interval of a histogram
+    static void finishInterval(metric& m);
+    /// append the current values to the log
+    void writeLog();
+
+    Oryol::Array<metric> metrics;
+    int64_t trackedBytes = 0;
+    int interval = 60;
+    int frameIndex = 0;
+    FILE* log = nullptr;
+    bool csv = false;
+    // number of metrics in the CSV header, -1 before the header is written
+    int numLogMetrics = -1;
+};
@@ -0,0 +1,163 @@
+//------------------------------------------------------------------------------
+//  OcclusionBuffer.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "OcclusionBuffer.h"
+#include "Core/Memory/Memory.h"
+#include "glm/common.hpp"
+
+using namespace Oryol;
+
+// occluders and occludees closer than this are ignored (no near-plane clipping)
+const float OcclusionBuffer::MinW = 0.5f;
+
+//------------------------------------------------------------------------------
+void
+OcclusionBuffer::Begin(const glm::mat4& viewProj_) {
+    this->viewProj = viewProj_;
+    Memory::Clear(this->depth, sizeof(this->depth));
+}
+
+//------------------------------------------------------------------------------
+glm::vec3
+OcclusionBuffer::toScreen(const glm::vec4& clip) {
+    const float invW = 1.0f / clip.w;
+    return glm::vec3((clip.x * invW * 0.5f + 0.5f) * Width,
+                     (clip.y * invW * 0.5f + 0.5f) * Height,
+                     invW);
+}
+
+//------------------------------------------------------------------------------
+void
+OcclusionBuffer::AddOccluder(const glm::vec3& eye, float x0, float x1, float y0, float y1, float z0, float z1, int faceMask) {
+    glm::vec4 c[8];
+    for (int i = 0; i < 8; i++) {
+        c[i] = this->viewProj * glm::vec4((i & 1) ? x1 : x0, (i & 2) ? y1 : y0, (i & 4) ? z1 : z0, 1.0f);
+    }
+    // only the faces the eye can see, the back faces are hidden by them anyway
+    if ((eye.x < x0) && (faceMask & NegX)) this->rasterizeQuad(c[0], c[2], c[6], c[4]);
+    if ((eye.x > x1) && (faceMask & PosX)) this->rasterizeQuad(c[1], c[3], c[7], c[5]);
+    if ((eye.y < y0) && (faceMask & NegY)) this->rasterizeQuad(c[0], c[1], c[5], c[4]);
+    if ((eye.y > y1) && (faceMask & PosY)) this->rasterizeQuad(c[2], c[3], c[7], c[6]);
+    if ((eye.z < z0) && (faceMask & NegZ)) this->rasterizeQuad(c[0], c[1], c[3], c[2]);
+    if ((eye.z > z1) && (faceMask & PosZ)) this->rasterizeQuad(c[4], c[5], c[7], c[6]);
+}
+
+//------------------------------------------------------------------------------
+void
+OcclusionBuffer::rasterizeQuad(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, const glm::vec4& c3) {
+    // quads crossing the near plane would need clipping, just skip
+    // them, this only makes the occlusion test less effective
+    if ((c0.w < MinW) || (c1.w < MinW) || (c2.w < MinW) || (c3.w < MinW)) {
+        return;
+    }
+    const glm::vec3 s0 = toScreen(c0);
+    const glm::vec3 s1 = toScreen(c1);
+    const glm::vec3 s2 = toScreen(c2);
+    const glm::vec3 s3 = toScreen(c3);
+    this->rasterizeTriangle(s0, s1, s2);
+    this->rasterizeTriangle(s0, s2, s3);
+}
+
+//------------------------------------------------------------------------------
+void
+OcclusionBuffer::rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (glm::abs(area) < 1.0e-6f) {
+        return;
+    }
+    // pixel centers inside the triangle's bounding rect
+    int minX = int(glm::max(glm::min(a.x, glm::min(b.x, c.x)) - 0.5f, 0.0f));
+    int minY = int(glm::max(glm::min(a.y, glm::min(b.y, c.y)) - 0.5f, 0.0f));
+    int maxX = int(glm::min(glm::max(a.x, glm::max(b.x, c.x)) - 0.5f, float(Width - 1)));
+    int maxY = int(glm::min(glm::max(a.y, glm::max(b.y, c.y)) - 0.5f, float(Height - 1)));
+    if ((minX > maxX) || (minY > maxY)) {
+        return;
+    }
+
+    // edge functions, normalized so that the inside is positive and
+    // the 3 values are the barycentric coordinates
+    const float invArea = 1.0f / area;
+    const float e0dx = (b.y - c.y) * invArea, e0dy = (c.x - b.x) * invArea;
+    const float e1dx = (c.y - a.y) * invArea, e1dy = (a.x - c.x) * invArea;
+    const float e2dx = (a.y - b.y) * invArea, e2dy = (b.x - a.x) * invArea;
+    const float px = minX + 0.5f;
+    const float py = minY + 0.5f;
+    float e0Row = ((px - b.x) * (b.y - c.y) + (py - b.y) * (c.x - b.x)) * invArea;
+    float e1Row = ((px - c.x) * (c.y - a.y) + (py - c.y) * (a.x - c.x)) * invArea;
+    float e2Row = ((px - a.x) * (a.y - b.y) + (py - a.y) * (b.x - a.x)) * invArea;
+    // branch-free inner loop so the compiler can vectorize it
+    const int num = maxX - minX + 1;
+    for (int y = minY; y <= maxY; y++) {
+        float* row = &this->depth[y][minX];
+        for (int i = 0; i < num; i++) {
+            const float e0 = e0Row + i * e0dx;
+            const float e1 = e1Row + i * e1dx;
+            const float e2 = e2Row + i * e2dx;
+            const float invW = e0 * a.z + e1 * b.z + e2 * c.z;
+            const bool write = (e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f) & (invW > row[i]);
+            row[i] = write ? invW : row[i];
+        }
+        e0Row += e0dy; e1Row += e1dy; e2Row += e2dy;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+OcclusionBuffer::End() {
+    // erode by one pixel (keep the farthest depth of the 3x3 neighbourhood),
+    // pixels outside the buffer count as not covered
+    for (int y = 0; y < Height; y++) {
+        const float* src = this->depth[y];
+        float* dst = this->scratch[y];
+        dst[0] = 0.0f;
+        dst[Width-1] = 0.0f;
+        for (int x = 1; x < Width-1; x++) {
+            dst[x] = glm::min(src[x-1], glm::min(src[x], src[x+1]));
+        }
+    }
+    for (int x = 0; x < Width; x++) {
+        this->depth[0][x] = 0.0f;
+        this->depth[Height-1][x] = 0.0f;
+    }
+    for (int y = 1; y < Height-1; y++) {
+        for (int x = 0; x < Width; x++) {
+            this->depth[y][x] = glm::min(this->scratch[y-1][x], glm::min(this->scratch[y][x], this->scratch[y+1][x]));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+OcclusionBuffer::BoxOccluded(float x0, float x1, float y0, float y1, float z0, float z1) const {
+    float minX = 1.0e30f, minY = 1.0e30f;
+    float maxX = -1.0e30f, maxY = -1.0e30f;
+    float maxInvW = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        const glm::vec4 clip = this->viewProj * glm::vec4((i & 1) ? x1 : x0, (i & 2) ? y1 : y0, (i & 4) ? z1 : z0, 1.0f);
+        if (clip.w < MinW) {
+            return false;
+        }
+        const glm::vec3 s = toScreen(clip);
+        minX = glm::min(minX, s.x); maxX = glm::max(maxX, s.x);
+        minY = glm::min(minY, s.y); maxY = glm::max(maxY, s.y);
+        maxInvW = glm::max(maxInvW, s.z);
+    }
+    // all pixels touched by the box's screen rect must have a closer occluder
+    const int px0 = int(glm::max(glm::floor(minX), 0.0f));
+    const int py0 = int(glm::max(glm::floor(minY), 0.0f));
+    const int px1 = int(glm::min(glm::floor(maxX), float(Width - 1)));
+    const int py1 = int(glm::min(glm::floor(maxY), float(Height - 1)));
+    if ((px0 > px1) || (py0 > py1)) {
+        return false;
+    }
+    for (int y = py0; y <= py1; y++) {
+        const float* row = this->depth[y];
+        for (int x = px0; x <= px1; x++) {
+            if (row[x] <= maxInvW) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
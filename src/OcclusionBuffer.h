@@ -0,0 +1,52 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class OcclusionBuffer
+    @brief small CPU depth buffer for conservative occlusion culling
+
+    Solid boxes (known to be completely inside the terrain) are
+    rasterized as occluders, then other boxes can be tested whether
+    they are completely hidden behind the occluders. The buffer stores
+    1/w (0 is 'no occluder'), which can be linearly interpolated in
+    screen space. After rasterization the occluders are eroded by one
+    pixel so that a covered pixel center also means the whole pixel
+    is covered (up to sub-pixel details of the silhouette).
+*/
+#include "Core/Types.h"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/mat4x4.hpp"
+
+class OcclusionBuffer {
+public:
+    static const int Width = 128;
+    static const int Height = 64;
+
+    /// start a new frame, clear the buffer
+    void Begin(const glm::mat4& viewProj);
+    /// box face bits for AddOccluder
+    enum Face {
+        NegX = (1<<0), PosX = (1<<1),
+        NegY = (1<<2), PosY = (1<<3),
+        NegZ = (1<<4), PosZ = (1<<5),
+        AllFaces = (1<<6)-1,
+    };
+    /// rasterize a solid box, faces not facing the eye position or not in faceMask are skipped
+    void AddOccluder(const glm::vec3& eyePos, float x0, float x1, float y0, float y1, float z0, float z1, int faceMask=AllFaces);
+    /// finish rasterizing occluders
+    void End();
+    /// return true if the box is completely hidden by occluders
+    bool BoxOccluded(float x0, float x1, float y0, float y1, float z0, float z1) const;
+
+    /// rasterize a triangle given in screen space (x, y, 1/w)
+    void rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+    /// rasterize a quad given by 4 clip-space corners, skipped if it crosses the near plane
+    void rasterizeQuad(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, const glm::vec4& c3);
+    /// convert clip-space position to screen space (x, y, 1/w)
+    static glm::vec3 toScreen(const glm::vec4& clip);
+
+    static const float MinW;
+    glm::mat4 viewProj;
+    float depth[Height][Width];
+    float scratch[Height][Width];
+};
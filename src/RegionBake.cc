@@ -0,0 +1,161 @@
+//------------------------------------------------------------------------------
+//  RegionBake.cc
+//
+//  Bake GenSimplex chunks into region files and measure chunks per
+//  second for baking, writing, random-access reads, streaming reads
+//  and regeneration (for comparison). Fails if a chunk can't be written
+//  or read back, so the rates are always for the full set of chunks.
+//
+//  regionbake [-dir path] [-level lvl] [-x regionX] [-y regionY] [-n regions] [-chunksize n]
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Core/Core.h"
+#include "Core/Log.h"
+#include "Core/Time/Clock.h"
+#include "VoxelGenerator.h"
+#include "RegionFile.h"
+#include "VisTree.h"
+#include <cstring>
+#include <cstdlib>
+
+using namespace Oryol;
+
+static VoxelGenerator voxelGenerator;
+
+//------------------------------------------------------------------------------
+static const char*
+arg(int argc, const char** argv, const char* name, const char* def) {
+    for (int i = 1; i < (argc - 1); i++) {
+        if (0 == strcmp(argv[i], name)) {
+            return argv[i + 1];
+        }
+    }
+    return def;
+}
+
+//------------------------------------------------------------------------------
+static double
+perSec(int num, Duration d) {
+    return d.AsSeconds() > 0.0 ? num / d.AsSeconds() : 0.0;
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, const char** argv) {
+    Core::Setup();
+    const char* dir = arg(argc, argv, "-dir", ".");
+    const int lvl = atoi(arg(argc, argv, "-level", "0"));
+    const int64_t regionX0 = atoll(arg(argc, argv, "-x", "0"));
+    const int64_t regionY0 = atoll(arg(argc, argv, "-y", "0"));
+    const int numRegions = atoi(arg(argc, argv, "-n", "1"));
+    const int chunkSize = atoi(arg(argc, argv, "-chunksize", "32"));
+    if (!VoxelGenerator::IsValidChunkSize(chunkSize)) {
+        Log::Warn("invalid chunk size %d (16, 32 or 64)\n", chunkSize);
+        Core::Discard();
+        return 10;
+    }
+    if ((lvl < 0) || (lvl >= VisTree::MaxNumLevels)) {
+        Log::Warn("invalid level %d (0..%d)\n", lvl, VisTree::MaxNumLevels - 1);
+        Core::Discard();
+        return 10;
+    }
+    voxelGenerator.Setup(chunkSize);
+
+    Duration genTime, writeTime, readTime, streamTime, regenTime;
+    int numChunks = 0;
+    int64_t fileBytes = 0;
+    char path[1024];
+    for (int64_t ry = regionY0; ry < regionY0 + numRegions; ry++) {
+        for (int64_t rx = regionX0; rx < regionX0 + numRegions; rx++) {
+            RegionFile::Path(path, sizeof(path), dir, lvl, rx, ry);
+            RegionFile regionFile;
+            if (!regionFile.Create(path, lvl, rx, ry,
+                voxelGenerator.VolumeSizeXY(), voxelGenerator.VolumeSizeXY(), VoxelGenerator::VolumeSizeZ)) {
+                Core::Discard();
+                return 10;
+            }
+            // bake: generate and append each chunk
+            for (int y = 0; y < RegionFile::Dim; y++) {
+                for (int x = 0; x < RegionFile::Dim; x++) {
+                    const VisBounds bounds = regionFile.ChunkBounds(x, y);
+                    TimePoint start = Clock::Now();
+                    Volume volume = voxelGenerator.GenSimplex(bounds);
+                    const float geomError = voxelGenerator.geomError(bounds);
+                    genTime += Clock::Since(start);
+                    start = Clock::Now();
+                    const bool written = regionFile.Write(x, y, volume, geomError);
+                    writeTime += Clock::Since(start);
+                    if (!written) {
+                        Log::Warn("failed to write chunk %d,%d to '%s'\n", x, y, path);
+                        regionFile.Close();
+                        Core::Discard();
+                        return 10;
+                    }
+                    numChunks++;
+                }
+            }
+            fileBytes += regionFile.FileSize();
+            regionFile.Close();
+
+            // random-access reads through the memory mapping
+            if (!regionFile.Open(path)) {
+                Core::Discard();
+                return 10;
+            }
+            Volume volume = voxelGenerator.initVolume();
+            TimePoint start = Clock::Now();
+            for (int y = 0; y < RegionFile::Dim; y++) {
+                for (int x = 0; x < RegionFile::Dim; x++) {
+                    float geomError;
+                    if (!regionFile.Read(x, y, volume, geomError)) {
+                        Log::Warn("failed to read chunk %d,%d from '%s'\n", x, y, path);
+                        regionFile.Close();
+                        Core::Discard();
+                        return 10;
+                    }
+                }
+            }
+            readTime += Clock::Since(start);
+
+            // sequential reads
+            RegionReader reader;
+            reader.Setup(&regionFile);
+            start = Clock::Now();
+            int numStreamed = 0;
+            while (reader.Next()) {
+                numStreamed++;
+            }
+            streamTime += Clock::Since(start);
+            const bool streamError = reader.Error;
+            reader.Discard();
+            regionFile.Close();
+            if (streamError || (RegionFile::NumChunks != numStreamed)) {
+                Log::Warn("streamed %d of %d chunks from '%s'%s\n", numStreamed, RegionFile::NumChunks, path,
+                    streamError ? " (corrupt chunk)" : "");
+                Core::Discard();
+                return 10;
+            }
+
+            // regenerating the same chunks
+            start = Clock::Now();
+            for (int y = 0; y < RegionFile::Dim; y++) {
+                for (int x = 0; x < RegionFile::Dim; x++) {
+                    const VisBounds bounds = regionFile.ChunkBounds(x, y);
+                    voxelGenerator.GenSimplex(bounds);
+                    voxelGenerator.geomError(bounds);
+                }
+            }
+            regenTime += Clock::Since(start);
+        }
+    }
+    const int64_t rawBytes = int64_t(numChunks) * voxelGenerator.VolumeSizeXY() * voxelGenerator.VolumeSizeXY() * VoxelGenerator::VolumeSizeZ;
+    Log::Info("regions: %d, chunks: %d, level: %d, chunk size: %d\n", numRegions * numRegions, numChunks, lvl, chunkSize);
+    Log::Info("file size: %d KB (%.1f%% of raw)\n", int(fileBytes / 1024), 100.0 * double(fileBytes) / double(rawBytes));
+    Log::Info("bake:   %10.0f chunks/s\n", perSec(numChunks, genTime + writeTime));
+    Log::Info("write:  %10.0f chunks/s\n", perSec(numChunks, writeTime));
+    Log::Info("read:   %10.0f chunks/s\n", perSec(numChunks, readTime));
+    Log::Info("stream: %10.0f chunks/s\n", perSec(numChunks, streamTime));
+    Log::Info("regen:  %10.0f chunks/s\n", perSec(numChunks, regenTime));
+    Core::Discard();
+    return 0;
+}
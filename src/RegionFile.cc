@@ -0,0 +1,302 @@
+//------------------------------------------------------------------------------
+//  RegionFile.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "RegionFile.h"
+#include "ChunkCodec.h"
+#include "VisTree.h"
+#include "Core/Assertion.h"
+#include "Core/Log.h"
+#include "Core/Memory/Memory.h"
+#if ORYOL_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::Create(const char* path, int lvl, int64_t regionX, int64_t regionY, int arraySizeX, int arraySizeY, int arraySizeZ) {
+    o_assert(!this->IsOpen());
+    o_assert((lvl >= 0) && (lvl < VisTree::MaxNumLevels));
+    o_assert((arraySizeX > 2) && (arraySizeX == arraySizeY) && (arraySizeX < 256) && (arraySizeZ > 2) && (arraySizeZ < 256));
+    this->file = fopen(path, "w+b");
+    if (!this->file) {
+        Log::Warn("RegionFile: failed to create '%s'\n", path);
+        return false;
+    }
+    this->hdr = header();
+    this->hdr.level = lvl;
+    this->hdr.regionX = regionX;
+    this->hdr.regionY = regionY;
+    this->hdr.arraySizeX = uint8_t(arraySizeX);
+    this->hdr.arraySizeY = uint8_t(arraySizeY);
+    this->hdr.arraySizeZ = uint8_t(arraySizeZ);
+    for (tableEntry& entry : this->table) {
+        entry = tableEntry();
+    }
+    if ((1 != fwrite(&this->hdr, sizeof(this->hdr), 1, this->file)) ||
+        (1 != fwrite(this->table, sizeof(this->table), 1, this->file)) ||
+        (0 != fflush(this->file))) {
+        Log::Warn("RegionFile: failed to write the header of '%s'\n", path);
+        this->Close();
+        return false;
+    }
+    this->fileSize = DataOffset;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::Open(const char* path) {
+    o_assert(!this->IsOpen());
+    this->file = fopen(path, "r+b");
+    if (!this->file) {
+        return false;
+    }
+    if ((1 != fread(&this->hdr, sizeof(this->hdr), 1, this->file)) ||
+        (Magic != this->hdr.magic) || (Version != this->hdr.version) || (Dim != this->hdr.dim) ||
+        (this->hdr.arraySizeX <= 2) || (this->hdr.arraySizeY != this->hdr.arraySizeX) || (this->hdr.arraySizeZ <= 2) ||
+        (this->hdr.level < 0) || (this->hdr.level >= VisTree::MaxNumLevels) ||
+        (1 != fread(this->table, sizeof(this->table), 1, this->file))) {
+        Log::Warn("RegionFile: '%s' is not a valid region file\n", path);
+        this->Close();
+        return false;
+    }
+    // the table comes from the file, reject entries outside of the data
+    // area so that reads through the mapping stay within the file
+    const long size = (0 == fseek(this->file, 0, SEEK_END)) ? ftell(this->file) : -1;
+    bool valid = (size >= DataOffset) && (uint64_t(size) <= 0xFFFFFFFF);
+    for (int i = 0; valid && (i < NumChunks); i++) {
+        const tableEntry& entry = this->table[i];
+        if (0 != entry.offset) {
+            valid = (entry.offset >= uint32_t(DataOffset)) &&
+                    (entry.size >= uint32_t(ChunkCodec::HeaderSize)) &&
+                    ((uint64_t(entry.offset) + entry.size) <= uint64_t(size));
+        }
+    }
+    if (!valid) {
+        Log::Warn("RegionFile: '%s' is truncated or has an invalid chunk table\n", path);
+        this->Close();
+        return false;
+    }
+    this->fileSize = uint32_t(size);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+RegionFile::Close() {
+    this->unmap();
+    if (this->file) {
+        fclose(this->file);
+        this->file = nullptr;
+    }
+    if (this->encodeBuffer) {
+        Memory::Free(this->encodeBuffer);
+        this->encodeBuffer = nullptr;
+    }
+    this->fileSize = 0;
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::IsOpen() const {
+    return nullptr != this->file;
+}
+
+//------------------------------------------------------------------------------
+int
+RegionFile::FileSize() const {
+    return int(this->fileSize);
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::map() {
+    if (this->mapped) {
+        return true;
+    }
+    fflush(this->file);
+    #if ORYOL_WINDOWS
+    HANDLE fileHandle = (HANDLE) _get_osfhandle(_fileno(this->file));
+    HANDLE mapping = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (NULL == mapping) {
+        return false;
+    }
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == ptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    this->mapHandle = mapping;
+    #else
+    void* ptr = mmap(nullptr, this->fileSize, PROT_READ, MAP_SHARED, fileno(this->file), 0);
+    if (MAP_FAILED == ptr) {
+        return false;
+    }
+    #endif
+    this->mapped = (const uint8_t*) ptr;
+    this->mappedSize = this->fileSize;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+RegionFile::unmap() {
+    if (this->mapped) {
+        #if ORYOL_WINDOWS
+        UnmapViewOfFile(this->mapped);
+        CloseHandle((HANDLE) this->mapHandle);
+        this->mapHandle = nullptr;
+        #else
+        munmap((void*) this->mapped, this->mappedSize);
+        #endif
+        this->mapped = nullptr;
+        this->mappedSize = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::Write(int x, int y, const Volume& vol, float geomError) {
+    o_assert(this->IsOpen());
+    o_assert((x >= 0) && (x < Dim) && (y >= 0) && (y < Dim));
+    o_assert((vol.ArraySizeX == this->hdr.arraySizeX) && (vol.ArraySizeY == this->hdr.arraySizeY) && (vol.ArraySizeZ == this->hdr.arraySizeZ));
+    if (!this->encodeBuffer) {
+        this->encodeBuffer = (uint8_t*) Memory::Alloc(ChunkCodec::MaxEncodedSize(vol.ArraySizeX, vol.ArraySizeY, vol.ArraySizeZ));
+    }
+    const int size = ChunkCodec::Encode(vol.Blocks, vol.ArraySizeX, vol.ArraySizeY, vol.ArraySizeZ, false, this->encodeBuffer);
+
+    // the mapping would not cover the appended data
+    this->unmap();
+    tableEntry& entry = this->table[y * Dim + x];
+    fseek(this->file, this->fileSize, SEEK_SET);
+    if (1 != fwrite(this->encodeBuffer, size, 1, this->file)) {
+        return false;
+    }
+    entry.offset = this->fileSize;
+    entry.size = uint32_t(size);
+    entry.geomError = geomError;
+    this->fileSize += size;
+    fseek(this->file, TableOffset + (y * Dim + x) * sizeof(tableEntry), SEEK_SET);
+    return 1 == fwrite(&entry, sizeof(entry), 1, this->file);
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::Contains(int x, int y) const {
+    o_assert_dbg((x >= 0) && (x < Dim) && (y >= 0) && (y < Dim));
+    return 0 != this->table[y * Dim + x].offset;
+}
+
+//------------------------------------------------------------------------------
+const uint8_t*
+RegionFile::ChunkData(int x, int y) {
+    if (!this->Contains(x, y) || !this->map()) {
+        return nullptr;
+    }
+    return this->mapped + this->table[y * Dim + x].offset;
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionFile::Read(int x, int y, Volume& vol, float& outGeomError) {
+    const uint8_t* data = this->ChunkData(x, y);
+    if (!data || !ChunkCodec::HasSize(data, vol.ArraySizeX, vol.ArraySizeY, vol.ArraySizeZ) ||
+        !ChunkCodec::Validate(data, int(this->table[y * Dim + x].size))) {
+        return false;
+    }
+    ChunkCodec::Decode(data, vol.Blocks);
+    outGeomError = this->table[y * Dim + x].geomError;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+RegionFile::ChunkBounds(int x, int y) const {
+    // the chunk size is the array size without the 1-voxel apron
+    const int64_t dim = int64_t(this->hdr.arraySizeX - 2) << this->hdr.level;
+    const int64_t x0 = (this->hdr.regionX * Dim + x) * dim;
+    const int64_t y0 = (this->hdr.regionY * Dim + y) * dim;
+    return VisBounds(x0, x0 + dim, y0, y0 + dim);
+}
+
+//------------------------------------------------------------------------------
+void
+RegionFile::Locate(const VisBounds& bounds, int64_t& outRegionX, int64_t& outRegionY, int& outX, int& outY) {
+    // chunk bounds are multiples of the chunk size, the region is
+    // rounded towards negative infinity
+    const int64_t dim = bounds.x1 - bounds.x0;
+    const int64_t cx = bounds.x0 / dim;
+    const int64_t cy = bounds.y0 / dim;
+    outRegionX = (cx >= 0) ? (cx / Dim) : ((cx - (Dim - 1)) / Dim);
+    outRegionY = (cy >= 0) ? (cy / Dim) : ((cy - (Dim - 1)) / Dim);
+    outX = int(cx - outRegionX * Dim);
+    outY = int(cy - outRegionY * Dim);
+}
+
+//------------------------------------------------------------------------------
+void
+RegionFile::Path(char* buf, int bufSize, const char* dir, int lvl, int64_t regionX, int64_t regionY) {
+    snprintf(buf, bufSize, "%s/r.%d.%lld.%lld.vxr", dir, lvl, (long long) regionX, (long long) regionY);
+}
+
+//------------------------------------------------------------------------------
+void
+RegionReader::Setup(RegionFile* regionFile) {
+    o_assert(regionFile && regionFile->IsOpen());
+    this->file = regionFile;
+    // visit the chunks in file order
+    this->numChunks = 0;
+    for (int i = 0; i < RegionFile::NumChunks; i++) {
+        if (0 != regionFile->table[i].offset) {
+            int j = this->numChunks++;
+            while ((j > 0) && (regionFile->table[this->order[j-1]].offset > regionFile->table[i].offset)) {
+                this->order[j] = this->order[j-1];
+                j--;
+            }
+            this->order[j] = i;
+        }
+    }
+    this->cur = 0;
+    this->Error = false;
+    const RegionFile::header& hdr = regionFile->hdr;
+    this->blocks = (uint8_t*) Memory::Alloc(hdr.arraySizeX * hdr.arraySizeY * hdr.arraySizeZ);
+    this->View = Volume();
+    this->View.Blocks = this->blocks;
+    this->View.ArraySizeX = hdr.arraySizeX;
+    this->View.ArraySizeY = hdr.arraySizeY;
+    this->View.ArraySizeZ = hdr.arraySizeZ;
+    this->View.OffsetX = this->View.OffsetY = this->View.OffsetZ = 1;
+    this->View.SizeX = hdr.arraySizeX - 2;
+    this->View.SizeY = hdr.arraySizeY - 2;
+    this->View.SizeZ = hdr.arraySizeZ - 2;
+}
+
+//------------------------------------------------------------------------------
+void
+RegionReader::Discard() {
+    if (this->blocks) {
+        Memory::Free(this->blocks);
+        this->blocks = nullptr;
+    }
+    this->file = nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool
+RegionReader::Next() {
+    if (this->Error || (this->cur >= this->numChunks)) {
+        return false;
+    }
+    const int i = this->order[this->cur++];
+    this->X = i % RegionFile::Dim;
+    this->Y = i / RegionFile::Dim;
+    this->Error = !this->file->Read(this->X, this->Y, this->View, this->GeomError);
+    return !this->Error;
+}
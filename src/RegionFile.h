@@ -0,0 +1,129 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class RegionFile
+    @brief a file with the voxel data of Dim x Dim chunks of one LOD level
+
+    File layout (little endian):
+
+    - header: magic, version, dim, level, region x/y, chunk array size
+      (chunk size plus the 1-voxel apron, so files of different chunk
+      sizes can't be mixed up)
+    - offset table: per chunk its file offset, encoded size and
+      geometric error (offset 0 means the chunk is not in the file)
+    - chunk data encoded with ChunkCodec
+
+    Chunks are always appended to the end of the file, writing a chunk
+    again only updates its table entry (the old data stays as garbage).
+    Reads go through a read-only memory mapping of the whole file which
+    is re-created after writes.
+*/
+#include "Core/Types.h"
+#include "Volume.h"
+#include "VisBounds.h"
+#include <cstdio>
+
+class RegionFile {
+public:
+    /// number of chunks along each side of a region
+    static const int Dim = 16;
+    static const int NumChunks = Dim * Dim;
+    static const uint32_t Magic = 0x47525856;     // 'VXRG'
+    static const uint32_t Version = 1;
+
+    /// create a new region file, overwrites an existing file, return false on error
+    bool Create(const char* path, int lvl, int64_t regionX, int64_t regionY, int arraySizeX, int arraySizeY, int arraySizeZ);
+    /// open an existing region file for reading and appending, fails on truncated files or invalid chunk tables
+    bool Open(const char* path);
+    /// close the file (must be called before destruction)
+    void Close();
+    /// return true if the file is open
+    bool IsOpen() const;
+
+    /// append a chunk (x, y are the chunk's coordinates in the region)
+    bool Write(int x, int y, const Volume& volume, float geomError);
+    /// return true if the file contains a chunk
+    bool Contains(int x, int y) const;
+    /// decompress a chunk into a volume with the file's array size, fails on corrupt chunk data
+    bool Read(int x, int y, Volume& volume, float& outGeomError);
+    /// get a chunk's encoded data from the memory mapping (valid until the next write)
+    const uint8_t* ChunkData(int x, int y);
+    /// get the bounds of a chunk (the chunk size follows from the header's array size)
+    VisBounds ChunkBounds(int x, int y) const;
+    /// size of the file in bytes
+    int FileSize() const;
+
+    /// get the region and in-region chunk coordinates of a chunk
+    static void Locate(const VisBounds& bounds, int64_t& outRegionX, int64_t& outRegionY, int& outX, int& outY);
+    /// build the file name of a region in a directory
+    static void Path(char* buf, int bufSize, const char* dir, int lvl, int64_t regionX, int64_t regionY);
+
+    struct header {
+        uint32_t magic = Magic;
+        uint32_t version = Version;
+        uint32_t dim = Dim;
+        int32_t level = 0;
+        int64_t regionX = 0;
+        int64_t regionY = 0;
+        uint8_t arraySizeX = 0;
+        uint8_t arraySizeY = 0;
+        uint8_t arraySizeZ = 0;
+        uint8_t pad = 0;
+        uint32_t pad2 = 0;
+    };
+    struct tableEntry {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        float geomError = 0.0f;
+    };
+    static const int TableOffset = sizeof(header);
+    static const int DataOffset = sizeof(header) + NumChunks * sizeof(tableEntry);
+
+    /// map the file for reading if not mapped yet
+    bool map();
+    /// remove the memory mapping
+    void unmap();
+
+    FILE* file = nullptr;
+    header hdr;
+    tableEntry table[NumChunks];
+    uint32_t fileSize = 0;
+    uint8_t* encodeBuffer = nullptr;
+    // read-only memory mapping of the file
+    const uint8_t* mapped = nullptr;
+    uint32_t mappedSize = 0;
+    void* mapHandle = nullptr;      // Windows only
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class RegionReader
+    @brief sequentially decode all chunks of a region file
+
+    Visits the chunks in file order (sequential reads of the mapping),
+    each decoded chunk is available as a Volume view into the reader's
+    buffer until the next call to Next().
+*/
+class RegionReader {
+public:
+    /// start reading the chunks of an open region file
+    void Setup(RegionFile* file);
+    /// discard the reader
+    void Discard();
+    /// decode the next chunk, return false when done or on a corrupt chunk (see Error)
+    bool Next();
+
+    /// the current chunk
+    int X = 0;
+    int Y = 0;
+    float GeomError = 0.0f;
+    Volume View;
+    /// set when Next() stopped at a chunk which failed to decode (X, Y is the chunk)
+    bool Error = false;
+
+    RegionFile* file = nullptr;
+    int order[RegionFile::NumChunks];
+    int numChunks = 0;
+    int cur = 0;
+    uint8_t* blocks = nullptr;
+};
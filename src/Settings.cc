@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+//  Settings.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Settings.h"
+#include "VoxelGenerator.h"
+#include "VisTree.h"
+#include "Core/Assertion.h"
+#include "Core/Log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+using namespace Oryol;
+
+static const char* knobNames[Settings::NumKnobs] = {
+    "tau", "geoms", "nodes", "jobs", "displaywidth", "chunksize"
+};
+
+//------------------------------------------------------------------------------
+const char*
+Settings::Name(int knob) {
+    o_assert_dbg((knob >= 0) && (knob < NumKnobs));
+    return knobNames[knob];
+}
+
+//------------------------------------------------------------------------------
+double
+Settings::Get(int knob) const {
+    switch (knob) {
+        case 0: return this->LodTau;
+        case 1: return this->NumGeoms;
+        case 2: return this->MaxNumNodes;
+        case 3: return this->JobsPerFrame;
+        case 4: return this->DisplayWidth;
+        case 5: return this->ChunkSize;
+        default: o_assert(false); return 0.0;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+Settings::Set(const char* name, const char* value) {
+    char* end = nullptr;
+    const double val = strtod(value, &end);
+    if ((end == value) || (*end != 0)) {
+        Log::Warn("Settings: invalid value '%s' for '%s'\n", value, name);
+        return false;
+    }
+    const int ival = int(val);
+    if (0 == strcmp(name, "tau") && (val > 0.0)) {
+        this->LodTau = float(val);
+    }
+    else if (0 == strcmp(name, "geoms") && (ival > 0)) {
+        this->NumGeoms = ival;
+    }
+    else if (0 == strcmp(name, "nodes") && ((0 == ival) || (ival >= VisTree::MinNumNodes)) && (ival <= (1<<24))) {
+        this->MaxNumNodes = ival;
+    }
+    else if (0 == strcmp(name, "jobs") && (ival > 0)) {
+        this->JobsPerFrame = ival;
+    }
+    else if (0 == strcmp(name, "displaywidth") && (ival > 0)) {
+        this->DisplayWidth = ival;
+    }
+    else if (0 == strcmp(name, "chunksize") && VoxelGenerator::IsValidChunkSize(ival)) {
+        this->ChunkSize = ival;
+    }
+    else {
+        bool known = false;
+        for (int i = 0; i < NumKnobs; i++) {
+            known |= 0 == strcmp(name, knobNames[i]);
+        }
+        if (known) {
+            Log::Warn("Settings: value %s out of range for '%s'\n", value, name);
+        }
+        else {
+            Log::Warn("Settings: unknown knob '%s'\n", name);
+        }
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static char*
+trim(char* str) {
+    while (isspace(*str)) {
+        str++;
+    }
+    char* end = str + strlen(str);
+    while ((end > str) && isspace(end[-1])) {
+        *--end = 0;
+    }
+    return str;
+}
+
+//------------------------------------------------------------------------------
+bool
+Settings::Load(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        Log::Warn("Settings: failed to open '%s'\n", path);
+        return false;
+    }
+    bool ok = true;
+    int lineNr = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        lineNr++;
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = 0;
+        }
+        char* str = trim(line);
+        if (0 == *str) {
+            continue;
+        }
+        char* eq = strchr(str, '=');
+        if (!eq) {
+            Log::Warn("Settings: %s:%d: expected 'key = value'\n", path, lineNr);
+            ok = false;
+            continue;
+        }
+        *eq = 0;
+        ok &= this->Set(trim(str), trim(eq + 1));
+    }
+    fclose(fp);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+void
+Settings::Dump() const {
+    for (int i = 0; i < NumKnobs; i++) {
+        Log::Info("%s = %g\n", knobNames[i], this->Get(i));
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Settings
+    @brief runtime tuning knobs for LOD, pools and job throughput
+
+    The knobs default to the values the tools used to hard-code. They
+    can be loaded from a config file with one 'key = value' per line
+    ('#' starts a comment) and overridden per knob on the command line
+    with '-key value', the tools apply them before setting up the
+    VisTree, geom pool and job loop.
+
+        tau             LOD threshold, screen-space error in pixels
+        geoms           number of geoms in the geom pool
+        nodes           VisTree node budget, 0 is only limited by the handle range,
+                        otherwise at least VisTree::MinNumNodes (36)
+        jobs            geom generation jobs per frame
+        displaywidth    display width for the screen-space error
+        chunksize       chunk size in voxels along x and y (16, 32 or 64)
+*/
+#include "Core/Types.h"
+#include "Config.h"
+
+class Settings {
+public:
+    float LodTau = 15.0f;
+    int NumGeoms = 700;
+    int MaxNumNodes = 0;
+    int JobsPerFrame = 1;
+    int DisplayWidth = 800;
+    int ChunkSize = Config::ChunkSizeXY;
+
+    /// number of knobs
+    static const int NumKnobs = 6;
+    /// name of a knob
+    static const char* Name(int knob);
+    /// get a knob's value
+    double Get(int knob) const;
+    /// set a knob by name, return false if the name or value is invalid
+    bool Set(const char* name, const char* value);
+    /// load knobs from a config file, return false on error
+    bool Load(const char* path);
+    /// log the knobs in config file format
+    void Dump() const;
+};
@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------
+//  Trace.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Trace.h"
+#include "MemTrack.h"
+#include "Core/Containers/Array.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Log.h"
+#include <cstdio>
+#include <mutex>
+
+using namespace Oryol;
+
+TimePoint Trace::start;
+int64_t Trace::startTicks = 0;
+
+struct event {
+    const char* name;
+    int64_t begin;
+    int64_t end;
+};
+
+struct ringBuffer {
+    event events[Trace::NumEvents];
+    uint32_t numRecorded;       // total number of events, wraps around the buffer
+    int threadIndex;
+    bool inUse;                 // false after the thread exited, the next new thread takes it over
+};
+
+static thread_local ringBuffer* threadBuffer = nullptr;
+static std::mutex buffersLock;
+static Array<ringBuffer*> buffers;
+
+// releases the thread's ring buffer when the thread exits, so that
+// threads which are created again and again (e.g. a new worker pool per
+// run) reuse the buffers instead of adding new ones
+struct threadExit {
+    bool registered = false;
+    ~threadExit() {
+        if (threadBuffer) {
+            std::lock_guard<std::mutex> lock(buffersLock);
+            threadBuffer->inUse = false;
+            threadBuffer = nullptr;
+        }
+    }
+};
+static thread_local threadExit threadExitHook;
+
+//------------------------------------------------------------------------------
+void
+Trace::Setup() {
+    start = Clock::Now();
+    startTicks = now();
+}
+
+//------------------------------------------------------------------------------
+void
+Trace::Discard() {
+    // threads must not record anymore
+    std::lock_guard<std::mutex> lock(buffersLock);
+    for (ringBuffer* buf : buffers) {
+        Memory::Free(buf);
+        MemTrack::Free(MemTrack::Tracing, MemTrack::CPU, sizeof(ringBuffer));
+    }
+    buffers.Clear();
+    threadBuffer = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void
+Trace::record(const char* name, int64_t begin, int64_t end) {
+    ringBuffer* buf = threadBuffer;
+    if (!buf) {
+        // first event of this thread, take over the buffer of an exited
+        // thread (keeping its events) or create a new one
+        std::lock_guard<std::mutex> lock(buffersLock);
+        for (ringBuffer* free : buffers) {
+            if (!free->inUse) {
+                buf = free;
+                break;
+            }
+        }
+        if (!buf) {
+            buf = (ringBuffer*) Memory::Alloc(sizeof(ringBuffer));
+            MemTrack::Alloc(MemTrack::Tracing, MemTrack::CPU, sizeof(ringBuffer));
+            buf->numRecorded = 0;
+            buf->threadIndex = buffers.Size();
+            buffers.Add(buf);
+        }
+        buf->inUse = true;
+        threadBuffer = buf;
+        threadExitHook.registered = true;
+    }
+    event& e = buf->events[buf->numRecorded++ & (NumEvents - 1)];
+    e.name = name;
+    e.begin = begin;
+    e.end = end;
+}
+
+//------------------------------------------------------------------------------
+int
+Trace::NumRecordedEvents() {
+    std::lock_guard<std::mutex> lock(buffersLock);
+    int num = 0;
+    for (const ringBuffer* buf : buffers) {
+        num += buf->numRecorded < uint32_t(NumEvents) ? int(buf->numRecorded) : NumEvents;
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+bool
+Trace::Write(const char* path) {
+    // events still being recorded by other threads while writing may be
+    // torn, this is meant for the main thread at a frame boundary or exit
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        Log::Warn("Trace: failed to create '%s'\n", path);
+        return false;
+    }
+    // calibrate the ticks against the clock over the whole run
+    const int64_t ticks = now() - startTicks;
+    const double usPerTick = ticks > 0 ? Clock::Since(start).AsMicroSeconds() / double(ticks) : 0.0;
+    std::lock_guard<std::mutex> lock(buffersLock);
+    fprintf(fp, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const ringBuffer* buf : buffers) {
+        // oldest event first
+        const uint32_t num = buf->numRecorded < uint32_t(NumEvents) ? buf->numRecorded : uint32_t(NumEvents);
+        for (uint32_t i = buf->numRecorded - num; i != buf->numRecorded; i++) {
+            const event& e = buf->events[i & (NumEvents - 1)];
+            fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", e.name, buf->threadIndex,
+                (e.begin - startTicks) * usPerTick, (e.end - e.begin) * usPerTick);
+            first = false;
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    const bool ok = 0 == ferror(fp);
+    fclose(fp);
+    return ok;
+}
@@ -0,0 +1,80 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Trace
+    @brief scoped timers recorded into per-thread ring buffers
+
+    TRACE_SCOPE(name) records the time spent in the enclosing scope
+    under a string literal name. Each thread records into its own ring
+    buffer which keeps the newest events, Write() exports all buffers
+    in the Chrome trace event format (load in chrome://tracing). When a
+    thread exits its buffer is handed over to the next new thread, so
+    the memory is bounded by the number of concurrent threads.
+
+    Scopes only exist if VOXEL_TRACE is defined (the cmake option of
+    the same name), otherwise TRACE_SCOPE compiles to nothing.
+
+    On x86 the timestamps are read with rdtsc (a Clock::Now() costs
+    about as much as the rest of the scope), they are converted to
+    time when writing, which assumes an invariant TSC.
+*/
+#include "Core/Types.h"
+#include "Core/Time/Clock.h"
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VOXELTEST_RDTSC (1)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+class Trace {
+public:
+    /// number of events kept per thread (power of 2)
+    static const int NumEvents = 1<<16;
+
+    /// start the trace clock
+    static void Setup();
+    /// free all ring buffers
+    static void Discard();
+    /// write the events of all threads as Chrome trace JSON, return false on error
+    static bool Write(const char* path);
+    /// number of events currently in all ring buffers
+    static int NumRecordedEvents();
+
+    /// current timestamp in ticks
+    static int64_t now() {
+        #if VOXELTEST_RDTSC
+        return int64_t(__rdtsc());
+        #else
+        return int64_t(Oryol::Clock::Since(start).AsNanoSeconds());
+        #endif
+    }
+    /// record a finished scope into the calling thread's ring buffer
+    static void record(const char* name, int64_t begin, int64_t end);
+
+    static Oryol::TimePoint start;
+    static int64_t startTicks;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class TraceScope
+    @brief records a trace event for its lifetime, use TRACE_SCOPE
+*/
+class TraceScope {
+public:
+    TraceScope(const char* name) : name(name), begin(Trace::now()) { }
+    ~TraceScope() {
+        Trace::record(this->name, this->begin, Trace::now());
+    }
+    const char* name;
+    int64_t begin;
+};
+
+#if VOXEL_TRACE
+#define TRACE_SCOPE(name) TraceScope traceScope_(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
@@ -3,6 +3,9 @@
 /**
     @class VisBounds
     @brief a 2D bounding area in the VisTree
+
+    World coordinates are 64-bit integers, convert to float only
+    relative to the camera origin (see Camera::Origin).
 */
 #include "Core/Types.h"
 #include "glm/exponential.hpp"
@@ -11,7 +14,7 @@ struct VisBounds {
     /// default constructor
     VisBounds() : x0(0), x1(0), y0(0), y1(0) { };
     /// constructor
-    VisBounds(int x0_, int x1_, int y0_, int y1_) : x0(x0_), x1(x1_), y0(y0_), y1(y1_) { };
+    VisBounds(int64_t x0_, int64_t x1_, int64_t y0_, int64_t y1_) : x0(x0_), x1(x1_), y0(y0_), y1(y1_) { };
 
-    int x0, x1, y0, y1;
+    int64_t x0, x1, y0, y1;
 };
\ No newline at end of file
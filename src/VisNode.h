@@ -5,49 +5,72 @@
     @brief a node in the VisTree
 */
 #include "Core/Types.h"
+#include "Core/Assertion.h"
 
 class VisNode {
 public:
     enum Flags {
-        GeomPending = (1<<0),   // geom is currently prepared for drawing
+        GeomPending = (1<<0),       // geom is currently prepared for drawing
+        ParentReleased = (1<<1),    // doesn't depend on the parent's geom as placeholder
+        Dirty = (1<<5),             // geom is outdated by a voxel edit and must be regenerated
     };
-    static const int16_t InvalidGeom = -1;
-    static const int16_t EmptyGeom = -2;
-    static const int16_t InvalidChild = -1;
-    static const int NumGeoms = 3;
+    // the number of child nodes depending on this node's geom
+    // as placeholder is stored in the flags
+    static const int PlaceholderRefShift = 2;
+    static const uint16_t PlaceholderRefMask = (7<<PlaceholderRefShift);
+    static const int32_t InvalidGeom = -1;
+    static const int32_t EmptyGeom = -2;
+    static const int32_t InvalidChild = -1;
     static const int NumChilds = 4;
+    // NOTE: only the data needed during traversal lives here (12 bytes),
+    // child nodes are always allocated as a block of 4 siblings
+    // in Morton order (child index = (y<<1)|x)
     uint16_t flags;
-    int16_t geoms[NumGeoms];       // up to 3 geoms
-    int16_t childs[NumChilds];     // 4 child nodes (or none)
+    int32_t geom;                  // first geom of a GeomPool geom chain
+    int32_t firstChild;            // index of first of 4 sibling nodes (or none)
 
     /// reset the node
     void Reset() {
         this->flags = 0;
-        for (int i = 0; i < NumGeoms; i++) {
-            this->geoms[i] = InvalidGeom;
-        }
-        for (int i = 0; i < NumChilds; i++) {
-            this->childs[i] = InvalidChild;
-        }
+        this->geom = InvalidGeom;
+        this->firstChild = InvalidChild;
     }
     /// return true if this is a leaf node
     bool IsLeaf() const {
-        return InvalidChild == this->childs[0];
+        return InvalidChild == this->firstChild;
+    }
+    /// get node index of a child node
+    int32_t Child(int childIndex) const {
+        o_assert_dbg(!this->IsLeaf() && (childIndex >= 0) && (childIndex < NumChilds));
+        return this->firstChild + childIndex;
     }
     /// return true if has node has a draw geom assigned
     bool HasGeom() const {
-        return InvalidGeom != this->geoms[0];
+        return InvalidGeom != this->geom;
     }
     /// return true if the node is an empty volume (doesn't need drawing even if visible)
     bool HasEmptyGeom() const {
-        return EmptyGeom == this->geoms[0];
+        return EmptyGeom == this->geom;
     }
     /// return true if the node needs geoms to be generated
     bool NeedsGeom() const {
-        return (InvalidGeom == this->geoms[0]) && !(this->flags & GeomPending);
+        return (InvalidGeom == this->geom) && !(this->flags & GeomPending);
     }
     /// return true if node is waiting for geom
     bool WaitsForGeom() const {
         return this->flags & GeomPending;
     }
+    /// return true if the node's geom must be regenerated (the old geom is drawn meanwhile)
+    bool NeedsRemesh() const {
+        return (this->flags & Dirty) && this->HasGeom() && !(this->flags & GeomPending);
+    }
+    /// get number of child nodes which depend on this node's geom as placeholder
+    int PlaceholderRefs() const {
+        return (this->flags & PlaceholderRefMask) >> PlaceholderRefShift;
+    }
+    /// set number of child nodes which depend on this node's geom as placeholder
+    void SetPlaceholderRefs(int refs) {
+        o_assert_dbg((refs >= 0) && (refs <= NumChilds));
+        this->flags = (this->flags & ~PlaceholderRefMask) | (refs << PlaceholderRefShift);
+    }
 };
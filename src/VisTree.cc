@@ -4,7 +4,13 @@
 #include "Pre.h"
 #include "Config.h"
 #include "VisTree.h"
+#include "Trace.h"
+#include "MemTrack.h"
+#include "Core/Log.h"
+#include "Core/Time/Clock.h"
 #include "glm/trigonometric.hpp"
+#include "glm/geometric.hpp"
+#include "glm/common.hpp"
 
 using namespace Oryol;
 
@@ -16,176 +22,1045 @@ VisTree::Setup(int displayWidth, float fov) {
     // (see: http://tulrich.com/geekstuff/sig-notes.pdf )
     this->K = displayWidth / (2.0f * glm::tan(fov*0.5f));
 
-    this->drawNodes.Reserve(MaxNumNodes);
-    this->freeNodes.Reserve(MaxNumNodes);
-    this->geomGenJobs.Reserve(MaxNumNodes);
-    this->freeGeoms.Reserve(MaxNumNodes);
-    this->traverseStack.Reserve(NumLevels);
-    for (int i = MaxNumNodes-1; i >=0; i--) {
-        this->freeNodes.Add(i);
+    o_assert((0 == this->MaxNumNodes) || ((this->MaxNumNodes >= MinNumNodes) && (this->MaxNumNodes <= (1<<HandleIndexBits))));
+    o_assert((this->ChunkSize > 0) && (0 == (RootSize % this->ChunkSize)));
+    this->numLevels = 0;
+    while ((this->ChunkSize << this->numLevels) < RootSize) {
+        this->numLevels++;
+    }
+    o_assert(((this->ChunkSize << this->numLevels) == RootSize) && (this->numLevels <= MaxNumLevels));
+    this->nodes.Reserve(InitialNumNodes);
+    this->cache.Reserve(InitialNumNodes);
+    this->chunks.Reserve(InitialNumNodes);
+    this->blockGenerations.Reserve(InitialNumNodes / VisNode::NumChilds);
+    this->drawNodes.Reserve(InitialNumNodes);
+    this->occluders.Reserve(InitialNumNodes);
+    this->prevDrawNodes.Reserve(InitialNumNodes);
+    this->freeNodeBlocks.Reserve(InitialNumNodes / VisNode::NumChilds);
+    this->geomGenJobs.Reserve(InitialNumNodes);
+    this->freeGeoms.Reserve(InitialNumNodes);
+    // each inner node on the path leaves its post-order item and its children on the stack
+    this->traverseStack.Reserve(this->numLevels * VisNode::NumChilds + 1);
+    this->traversePath.Reserve(this->numLevels + 1);
+    // roots are allocated on the first traversal, around the camera
+    for (rootSlot& root : this->roots) {
+        root = rootSlot();
     }
-    this->rootNode = this->AllocNode();
 }
 
 //------------------------------------------------------------------------------
 void
 VisTree::Discard() {
-    this->freeNodes.Clear();
+    this->freeNodeBlocks.Clear();
+    this->nodes.Clear();
+    this->cache.Clear();
+    this->chunks.Clear();
+    this->blockGenerations.Clear();
+    MemTrack::Resize(MemTrack::Nodes, MemTrack::CPU, this->trackedNodes, 0);
+    MemTrack::Resize(MemTrack::Jobs, MemTrack::CPU, this->trackedJobs, 0);
+    MemTrack::Resize(MemTrack::Traversal, MemTrack::CPU, this->trackedTraversal, 0);
 }
 
 //------------------------------------------------------------------------------
 VisNode&
-VisTree::NodeAt(int16_t nodeIndex) {
-    o_assert_dbg((nodeIndex >= 0) && (nodeIndex < MaxNumNodes));
+VisTree::NodeAt(int32_t nodeIndex) {
+    o_assert_dbg((nodeIndex >= 0) && (nodeIndex < this->nodes.Size()));
     return this->nodes[nodeIndex];
 }
 
 //------------------------------------------------------------------------------
-int16_t
-VisTree::AllocNode() {
-    int16_t index = this->freeNodes.PopBack();
-    VisNode& node = this->nodes[index];
-    node.Reset();
+int32_t
+VisTree::AllocNodeBlock() {
+    int32_t index;
+    if (!this->freeNodeBlocks.Empty()) {
+        index = this->freeNodeBlocks.PopBack();
+    }
+    else {
+        // grow the node store by one block, unless over budget
+        index = this->nodes.Size();
+        const int maxNumNodes = this->MaxNumNodes > 0 ? this->MaxNumNodes : (1<<HandleIndexBits);
+        if ((index + VisNode::NumChilds) > maxNumNodes) {
+            return VisNode::InvalidChild;
+        }
+        for (int i = 0; i < VisNode::NumChilds; i++) {
+            this->nodes.Add(VisNode());
+            this->cache.Add(nodeCache());
+            this->chunks.Add(nodeChunk());
+        }
+        this->blockGenerations.Add(0);
+    }
+    for (int i = 0; i < VisNode::NumChilds; i++) {
+        this->nodes[index + i].Reset();
+        this->cache[index + i] = nodeCache();
+        this->chunks[index + i].valid = false;
+    }
+    const int numUsedNodes = this->nodes.Size() - this->NumFreeNodes();
+    this->MaxUsedNodes = numUsedNodes > this->MaxUsedNodes ? numUsedNodes : this->MaxUsedNodes;
     return index;
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::FreeGeoms(int16_t nodeIndex) {
-    VisNode& node = this->NodeAt(nodeIndex);
-    for (int geomIndex = 0; geomIndex < VisNode::NumGeoms; geomIndex++) {
-        if (node.geoms[geomIndex] >= 0) {
-            this->freeGeoms.Add(node.geoms[geomIndex]);
-            node.geoms[geomIndex] = VisNode::InvalidGeom;
-        }
-        else {
-            break;
-        }
+VisTree::FreeNodeBlock(int32_t firstNodeIndex) {
+    o_assert_dbg(0 == (firstNodeIndex % VisNode::NumChilds));
+    // invalidates all handles to the block's nodes
+    this->blockGenerations[firstNodeIndex / VisNode::NumChilds]++;
+    this->freeNodeBlocks.Add(firstNodeIndex);
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::NumFreeNodes() const {
+    return this->freeNodeBlocks.Size() * VisNode::NumChilds;
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::NumNodes() const {
+    return this->nodes.Size();
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::NodeMemory() const {
+    return this->nodes.Capacity() * sizeof(VisNode) +
+           this->cache.Capacity() * sizeof(nodeCache) +
+           this->chunks.Capacity() * sizeof(nodeChunk) +
+           this->blockGenerations.Capacity() * sizeof(uint8_t) +
+           this->freeNodeBlocks.Capacity() * sizeof(int32_t);
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::TrackMemory() {
+    MemTrack::Resize(MemTrack::Nodes, MemTrack::CPU, this->trackedNodes, this->NodeMemory());
+    MemTrack::Resize(MemTrack::Jobs, MemTrack::CPU, this->trackedJobs,
+        this->geomGenJobs.Capacity() * sizeof(GeomGenJob) +
+        this->freeGeoms.Capacity() * sizeof(int32_t));
+    MemTrack::Resize(MemTrack::Traversal, MemTrack::CPU, this->trackedTraversal,
+        sizeof(this->occlusionBuffer) +
+        this->occluders.Capacity() * sizeof(occluderItem) +
+        this->drawNodes.Capacity() * sizeof(int32_t) +
+        this->prevDrawNodes.Capacity() * sizeof(int32_t) +
+        this->traverseStack.Capacity() * sizeof(traverseItem) +
+        this->traversePath.Capacity() * sizeof(int32_t));
+}
+
+//------------------------------------------------------------------------------
+VisTree::NodeHandle
+VisTree::Handle(int32_t nodeIndex) const {
+    o_assert_dbg((nodeIndex >= 0) && (nodeIndex < this->nodes.Size()));
+    const uint32_t generation = this->blockGenerations[nodeIndex / VisNode::NumChilds];
+    return (generation << HandleIndexBits) | uint32_t(nodeIndex);
+}
+
+//------------------------------------------------------------------------------
+int32_t
+VisTree::Lookup(NodeHandle handle) const {
+    // the generation only has 8 bits, a handle held while its block
+    // is freed and reused 256 times would resolve again, handles are
+    // only kept for a few frames
+    if (InvalidHandle == handle) {
+        return VisNode::InvalidChild;
+    }
+    const int32_t nodeIndex = handle & HandleIndexMask;
+    if ((nodeIndex >= this->nodes.Size()) ||
+        (this->blockGenerations[nodeIndex / VisNode::NumChilds] != (handle >> HandleIndexBits))) {
+        return VisNode::InvalidChild;
     }
+    return nodeIndex;
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::Split(int16_t nodeIndex) {
-    // turns a leaf node into an inner node, do NOT free geom
+VisTree::FreeGeoms(int32_t nodeIndex) {
     VisNode& node = this->NodeAt(nodeIndex);
-    o_assert_dbg(node.IsLeaf());
-    for (int childIndex = 0; childIndex < VisNode::NumChilds; childIndex++) {
-        o_assert_dbg(VisNode::InvalidChild == node.childs[childIndex]);
-        node.childs[childIndex] = this->AllocNode();
+    if (node.geom >= 0) {
+        // the GeomPool frees the entire chain
+        this->freeGeoms.Add(node.geom);
+        node.geom = VisNode::InvalidGeom;
+        this->numSideEffects++;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+VisTree::Split(int32_t nodeIndex) {
+    // turns a leaf node into an inner node, do NOT free geom
+    o_assert_dbg(this->NodeAt(nodeIndex).IsLeaf());
+    int32_t firstChild = this->AllocNodeBlock();
+    if (VisNode::InvalidChild == firstChild) {
+        this->NumFailedSplits++;
+        return false;
     }
+    VisNode& node = this->NodeAt(nodeIndex);
+    node.firstChild = firstChild;
     node.flags &= ~VisNode::GeomPending;
+    this->NumSplits++;
+    // the node's geom (if any) is the placeholder for all children
+    // until they have their own geoms
+    if (node.geom >= 0) {
+        node.SetPlaceholderRefs(VisNode::NumChilds);
+    }
+    else {
+        for (int i = 0; i < VisNode::NumChilds; i++) {
+            this->NodeAt(firstChild + i).flags |= VisNode::ParentReleased;
+        }
+    }
+    this->numSideEffects++;
+    return true;
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::Merge(int16_t nodeIndex) {
+VisTree::Merge(int32_t nodeIndex) {
     // turns an inner node into a leaf node by recursively removing
     // children and any encountered draw geoms
     VisNode& node = this->NodeAt(nodeIndex);
-    for (int childIndex = 0; childIndex < VisNode::NumChilds; childIndex++) {
-        if (VisNode::InvalidChild != node.childs[childIndex]) {
-            VisNode& childNode = this->NodeAt(node.childs[childIndex]);
-            this->FreeGeoms(node.childs[childIndex]);
-            this->Merge(node.childs[childIndex]);
-            this->freeNodes.Add(node.childs[childIndex]);
-            node.childs[childIndex] = VisNode::InvalidChild;
+    if (!node.IsLeaf()) {
+        for (int childIndex = 0; childIndex < VisNode::NumChilds; childIndex++) {
+            this->FreeGeoms(node.Child(childIndex));
+            this->Merge(node.Child(childIndex));
+            // a geom arriving for a pending child must be dropped by ApplyGeoms
+            this->NodeAt(node.Child(childIndex)).Reset();
+        }
+        this->FreeNodeBlock(node.firstChild);
+        node.firstChild = VisNode::InvalidChild;
+        node.SetPlaceholderRefs(0);
+        this->NumMerges++;
+        this->numSideEffects++;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::releaseParentPlaceholder(int32_t nodeIndex) {
+    // called during traversal when a node no longer needs its parent
+    // as placeholder (it's ready to draw, invisible or was split),
+    // each node releases its parent only once
+    VisNode& node = this->NodeAt(nodeIndex);
+    if (!(node.flags & VisNode::ParentReleased)) {
+        node.flags |= VisNode::ParentReleased;
+        o_assert_dbg((this->traversePath.Size() > 1) && (this->traversePath.Back() == nodeIndex));
+        const int32_t parentIndex = this->traversePath[this->traversePath.Size() - 2];
+        VisNode& parent = this->NodeAt(parentIndex);
+        const int refs = parent.PlaceholderRefs() - 1;
+        parent.SetPlaceholderRefs(refs);
+        if (0 == refs) {
+            this->FreeGeoms(parentIndex);
         }
     }
 }
 
+//------------------------------------------------------------------------------
+bool
+VisTree::CheckInvariants() const {
+    // all node blocks are either reachable from the root or free, no
+    // geom is used twice or used while waiting to be freed, placeholder
+    // reference counts match the children, and inner nodes only hold a
+    // geom while children depend on it (except below a merging node, which
+    // isn't traversed until the merge is done or cancelled)
+    Oryol::Array<int32_t> geoms;
+    bool valid = true;
+    int numBlocks = 0;
+    for (const rootSlot& root : this->roots) {
+        if (VisNode::InvalidChild != root.Node) {
+            numBlocks += this->checkSubtree(root.Node, false, geoms, valid) + 1;
+        }
+    }
+    const int numNodeBlocks = this->nodes.Size() / VisNode::NumChilds;
+    if ((numBlocks + this->freeNodeBlocks.Size()) != numNodeBlocks) {
+        Log::Warn("VisTree: %d node blocks in tree, %d free, expected %d\n",
+            numBlocks, this->freeNodeBlocks.Size(), numNodeBlocks);
+        valid = false;
+    }
+    for (int i = 0; i < geoms.Size(); i++) {
+        for (int j = i + 1; j < geoms.Size(); j++) {
+            if (geoms[i] == geoms[j]) {
+                Log::Warn("VisTree: geom %d used by multiple nodes\n", geoms[i]);
+                valid = false;
+            }
+        }
+        for (int32_t freeGeom : this->freeGeoms) {
+            if (geoms[i] == freeGeom) {
+                Log::Warn("VisTree: geom %d used and freed\n", geoms[i]);
+                valid = false;
+            }
+        }
+    }
+    return valid;
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::checkSubtree(int32_t nodeIndex, bool merging, Oryol::Array<int32_t>& geoms, bool& valid) const {
+    const VisNode& node = this->nodes[nodeIndex];
+    if (node.geom >= 0) {
+        geoms.Add(node.geom);
+    }
+    if (node.IsLeaf()) {
+        if (node.PlaceholderRefs() != 0) {
+            Log::Warn("VisTree: leaf node %d has placeholder refs\n", nodeIndex);
+            valid = false;
+        }
+        return 0;
+    }
+    int numBlocks = 1;
+    int refs = 0;
+    // an inner node waiting for its own geom is being merged
+    const bool childsMerging = merging || node.WaitsForGeom();
+    for (int i = 0; i < VisNode::NumChilds; i++) {
+        const int32_t childIndex = node.Child(i);
+        if (!(this->nodes[childIndex].flags & VisNode::ParentReleased)) {
+            refs++;
+        }
+        numBlocks += this->checkSubtree(childIndex, childsMerging, geoms, valid);
+    }
+    if (refs != node.PlaceholderRefs()) {
+        Log::Warn("VisTree: node %d has %d placeholder refs, expected %d\n", nodeIndex, node.PlaceholderRefs(), refs);
+        valid = false;
+    }
+    if ((node.geom >= 0) && (0 == refs) && !merging) {
+        Log::Warn("VisTree: inner node %d leaks geom %d\n", nodeIndex, node.geom);
+        valid = false;
+    }
+    return numBlocks;
+}
+
 //------------------------------------------------------------------------------
 float
-VisTree::ScreenSpaceError(const VisBounds& bounds, int lvl, int posX, int posY) const {
+VisTree::ScreenSpaceError(const VisBounds& bounds, float geomError, int64_t posX, int64_t posY) const {
     // see http://tulrich.com/geekstuff/sig-notes.pdf
-
-    // we just fudge the geometric error of the chunk by doubling it for
-    // each tree level
-    const float delta = float(1<<lvl);
     const float D = MinDist(posX, posY, bounds)+1.0f;
-    float rho = (delta/D) * this->K;
+    float rho = (geomError/D) * this->K;
     return rho;
 }
 
+//------------------------------------------------------------------------------
+float
+VisTree::GeomError(int32_t nodeIndex, int lvl) const {
+    // the geometric error is only known once a node's chunk has been
+    // generated, an inner node never has less error than its children,
+    // and estimates it from them when it wasn't generated itself (twice
+    // as wide columns roughly double the height steps), everything else
+    // falls back to doubling the error for each level
+    const float defaultError = float(1<<lvl);
+    if (!this->UseGeomError) {
+        return defaultError;
+    }
+    const nodeChunk& chunk = this->chunks[nodeIndex];
+    const VisNode& node = this->nodes[nodeIndex];
+    float childError = -1.0f;
+    if (!node.IsLeaf()) {
+        for (int i = 0; i < VisNode::NumChilds; i++) {
+            const nodeChunk& childChunk = this->chunks[node.Child(i)];
+            if (!childChunk.valid) {
+                childError = -1.0f;
+                break;
+            }
+            childError = childChunk.geomError > childError ? childChunk.geomError : childError;
+        }
+    }
+    if (chunk.valid) {
+        return chunk.geomError > childError ? chunk.geomError : childError;
+    }
+    else if (childError >= 0.0f) {
+        return 2.0f * childError;
+    }
+    return defaultError;
+}
+
 //------------------------------------------------------------------------------
 void
 VisTree::Traverse(const Camera& camera) {
     // traverse the entire tree to find draw nodes
     // split and merge nodes based required LOD,
-    int lvl = NumLevels;
-    int nodeIndex = this->rootNode;
-    int posX = camera.Pos.x;
-    int posY = camera.Pos.z;
-    VisBounds bounds = VisTree::Bounds(lvl, 0, 0);
+    TRACE_SCOPE("VisTree::Traverse");
+    this->frameIndex++;
+    // the arrays only grow between traversals (jobs, freed geoms, splits)
+    this->TrackMemory();
+    this->NumVisitedNodes = 0;
+    this->NumReusedNodes = 0;
+    this->originX = int64_t(camera.Origin.x);
+    this->originY = int64_t(camera.Origin.z);
+    this->updateCoherence(camera);
+    if (this->OcclusionCulling) {
+        this->updateOcclusion(camera);
+    }
+    this->updateRoots(camera);
+    this->purgeJobs();
+    if (this->TemporalCoherence && !this->ValidateCoherence) {
+        bool reuseAll = true;
+        for (const rootSlot& root : this->roots) {
+            reuseAll &= this->canReuse(root.Node);
+        }
+        if (reuseAll) {
+            // nothing changed enough to matter, keep last frame's draw nodes
+            this->NumOccludedNodes = 0;
+            for (const rootSlot& root : this->roots) {
+                this->cache[root.Node].frame = this->frameIndex;
+                this->NumOccludedNodes += this->cache[root.Node].numOccluded;
+            }
+            this->NumReusedNodes = NumRoots;
+            return;
+        }
+    }
+    const glm::dvec3 worldPos = camera.WorldPos();
+    const int64_t posX = int64_t(glm::floor(worldPos.x));
+    const int64_t posY = int64_t(glm::floor(worldPos.z));
+    this->prevDrawNodes.Clear();
+    for (int32_t drawNode : this->drawNodes) {
+        this->prevDrawNodes.Add(drawNode);
+    }
     this->drawNodes.Clear();
-    this->traverse(camera, nodeIndex, bounds, lvl, posX, posY);
+    this->NumOccludedNodes = 0;
+    for (const rootSlot& root : this->roots) {
+        const VisBounds bounds(root.CellX * RootSize, (root.CellX + 1) * RootSize,
+                               root.CellY * RootSize, (root.CellY + 1) * RootSize);
+        this->traverse(camera, root.Node, bounds, this->numLevels, posX, posY);
+        this->NumOccludedNodes += this->cache[root.Node].numOccluded;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::purgeJobs() {
+    // jobs of merged nodes, recycled roots, or nodes which split before
+    // their geom arrived would only be dropped by ApplyGeoms, but the
+    // queue is taken from the back: while the camera outruns the jobs
+    // they pile up at the front (and their handles could resolve again
+    // after the node block was reused 256 times)
+    int num = 0;
+    for (int i = 0; i < this->geomGenJobs.Size(); i++) {
+        const int32_t nodeIndex = this->Lookup(this->geomGenJobs[i].Node);
+        if ((VisNode::InvalidChild != nodeIndex) && this->NodeAt(nodeIndex).WaitsForGeom()) {
+            if (num != i) {
+                this->geomGenJobs[num] = this->geomGenJobs[i];
+            }
+            num++;
+        }
+    }
+    this->NumPurgedJobs += this->geomGenJobs.Size() - num;
+    while (this->geomGenJobs.Size() > num) {
+        this->geomGenJobs.PopBack();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::updateRoots(const Camera& camera) {
+    // the grid is re-centered once the camera is a quarter root size
+    // past the center root's edges (so that flying along an edge doesn't
+    // recycle roots back and forth), a root whose slot now belongs
+    // to another cell is merged and starts over as a leaf in the new cell
+    const glm::dvec3 worldPos = camera.WorldPos();
+    const double hysteresis = RootSize / 4;
+    const int64_t camCellX = int64_t(glm::floor(worldPos.x / RootSize));
+    const int64_t camCellY = int64_t(glm::floor(worldPos.z / RootSize));
+    if (!this->rootsValid ||
+        (worldPos.x < (this->rootCenterX * RootSize - hysteresis)) ||
+        (worldPos.x > ((this->rootCenterX + 1) * RootSize + hysteresis)) ||
+        (worldPos.z < (this->rootCenterY * RootSize - hysteresis)) ||
+        (worldPos.z > ((this->rootCenterY + 1) * RootSize + hysteresis))) {
+        this->rootCenterX = camCellX;
+        this->rootCenterY = camCellY;
+    }
+    const int64_t half = RootGridDim / 2;
+    for (int64_t cellY = this->rootCenterY - half; cellY <= this->rootCenterY + half; cellY++) {
+        for (int64_t cellX = this->rootCenterX - half; cellX <= this->rootCenterX + half; cellX++) {
+            // toroidal slot index, also for negative cells
+            const int slotX = int(((cellX % RootGridDim) + RootGridDim) % RootGridDim);
+            const int slotY = int(((cellY % RootGridDim) + RootGridDim) % RootGridDim);
+            rootSlot& root = this->roots[slotY * RootGridDim + slotX];
+            if ((VisNode::InvalidChild != root.Node) && (root.CellX == cellX) && (root.CellY == cellY)) {
+                continue;
+            }
+            if (VisNode::InvalidChild != root.Node) {
+                // frees the subtree's nodes and geoms, and invalidates
+                // handles of pending jobs (the root's block is freed too)
+                this->Merge(root.Node);
+                this->FreeGeoms(root.Node);
+                this->FreeNodeBlock(root.Node);
+                this->NumRecycledRoots++;
+            }
+            // a root is the first node of its own block, the
+            // other 3 nodes of the block stay unused
+            root.Node = this->AllocNodeBlock();
+            o_assert(VisNode::InvalidChild != root.Node);
+            root.CellX = cellX;
+            root.CellY = cellY;
+            this->numSideEffects++;
+        }
+    }
+    this->rootsValid = true;
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::updateOcclusion(const Camera& camera) {
+    TRACE_SCOPE("VisTree::updateOcclusion");
+    // the occluders are the chunks drawn in the previous frame, each
+    // contributes one box per cell from the ground up to the lowest
+    // column in the cell, these are completely inside the terrain;
+    // leaves tested against the buffer must be re-evaluated whenever
+    // the occluders change, so this counts as camera movement
+    bool occludersChanged = this->drawNodes.Size() != this->prevDrawNodes.Size();
+    for (int i = 0; !occludersChanged && (i < this->drawNodes.Size()); i++) {
+        occludersChanged = this->drawNodes[i] != this->prevDrawNodes[i];
+    }
+    if (!(this->cameraMoved || occludersChanged)) {
+        return;
+    }
+    this->cameraMoved = true;
+    TimePoint start = Clock::Now();
+    this->NumOccluders = 0;
+    this->occlusionBuffer.Begin(camera.ViewProj);
+    // distant chunks only contribute a single box (or nothing when
+    // smaller than a few pixels), rasterizing tiny boxes costs more
+    // than it helps
+    const float pixelsPerUnit = camera.Proj[0][0] * OcclusionBuffer::Width * 0.5f;
+    const float minPixels = 2.0f;
+    const glm::dvec3 worldPos = camera.WorldPos();
+    const int64_t posX = int64_t(glm::floor(worldPos.x));
+    const int64_t posY = int64_t(glm::floor(worldPos.z));
+    this->occluders.Clear();
+    for (int32_t nodeIndex : this->drawNodes) {
+        const nodeChunk& chunk = this->chunks[nodeIndex];
+        if (!chunk.valid) {
+            continue;
+        }
+        const float dist = MinDist(posX, posY, chunk.bounds) + 1.0f;
+        if (((chunk.bounds.x1 - chunk.bounds.x0) * pixelsPerUnit) >= (minPixels * dist)) {
+            this->occluders.Add(occluderItem(nodeIndex, dist));
+        }
+    }
+    // front to back, so that chunks hidden by closer chunks can be skipped
+    for (int i = 1; i < this->occluders.Size(); i++) {
+        const occluderItem item = this->occluders[i];
+        int j = i - 1;
+        for (; (j >= 0) && (this->occluders[j].Dist > item.Dist); j--) {
+            this->occluders[j+1] = this->occluders[j];
+        }
+        this->occluders[j+1] = item;
+    }
+    for (const occluderItem& item : this->occluders) {
+        const nodeChunk& chunk = this->chunks[item.NodeIndex];
+        const float chunkX0 = float(chunk.bounds.x0 - this->originX);
+        const float chunkY0 = float(chunk.bounds.y0 - this->originY);
+        const int chunkSize = int(chunk.bounds.x1 - chunk.bounds.x0);
+        if (this->occlusionBuffer.BoxOccluded(chunkX0, chunkX0 + chunkSize, 0.0f, chunk.maxHeight, chunkY0, chunkY0 + chunkSize)) {
+            continue;
+        }
+        this->NumOccluders++;
+        const float chunkPixels = (chunkSize * pixelsPerUnit) / item.Dist;
+        if ((chunkPixels / nodeChunk::NumCells) < minPixels) {
+            uint8_t minHeight = 0xFF;
+            for (int x = 0; x < nodeChunk::NumCells; x++) {
+                for (int y = 0; y < nodeChunk::NumCells; y++) {
+                    minHeight = chunk.minHeights[x][y] < minHeight ? chunk.minHeights[x][y] : minHeight;
+                }
+            }
+            this->occlusionBuffer.AddOccluder(camera.Pos,
+                chunkX0, chunkX0 + chunkSize, 0.0f, minHeight, chunkY0, chunkY0 + chunkSize);
+            continue;
+        }
+        // side faces towards an at least as high neighbour cell are
+        // inside the solid and can be skipped
+        const int cellSize = chunkSize / nodeChunk::NumCells;
+        const int last = nodeChunk::NumCells - 1;
+        for (int x = 0; x < nodeChunk::NumCells; x++) {
+            for (int y = 0; y < nodeChunk::NumCells; y++) {
+                const uint8_t h = chunk.minHeights[x][y];
+                if (0 == h) {
+                    continue;
+                }
+                int faces = OcclusionBuffer::NegY | OcclusionBuffer::PosY;
+                if ((0 == x) || (chunk.minHeights[x-1][y] < h)) faces |= OcclusionBuffer::NegX;
+                if ((last == x) || (chunk.minHeights[x+1][y] < h)) faces |= OcclusionBuffer::PosX;
+                if ((0 == y) || (chunk.minHeights[x][y-1] < h)) faces |= OcclusionBuffer::NegZ;
+                if ((last == y) || (chunk.minHeights[x][y+1] < h)) faces |= OcclusionBuffer::PosZ;
+                const float x0 = chunkX0 + x * cellSize;
+                const float y0 = chunkY0 + y * cellSize;
+                this->occlusionBuffer.AddOccluder(camera.Pos,
+                    x0, x0 + cellSize, 0.0f, h, y0, y0 + cellSize, faces);
+            }
+        }
+    }
+    this->occlusionBuffer.End();
+    this->OcclusionTime = Clock::Since(start);
+}
+
+//------------------------------------------------------------------------------
+bool
+VisTree::nodeOccluded(int32_t nodeIndex, const VisBounds& bounds) const {
+    // without height information, assume the highest possible terrain
+    const nodeChunk& chunk = this->chunks[nodeIndex];
+    const float maxHeight = chunk.valid ? chunk.maxHeight : Config::ChunkSizeZ + 2;
+    return this->occlusionBuffer.BoxOccluded(bounds.x0 - this->originX, bounds.x1 - this->originX, 0.0f, maxHeight,
+                                             bounds.y0 - this->originY, bounds.y1 - this->originY);
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::ApplyHeights(NodeHandle handle, const VisBounds& bounds, const HeightField& hf) {
+    // a column with height h is solid up to h, the lowest column
+    // of a cell gives a solid box, the highest column of the chunk
+    // is the top of its geometry
+    const int32_t nodeIndex = this->Lookup(handle);
+    if (VisNode::InvalidChild == nodeIndex) {
+        return;
+    }
+    nodeChunk& chunk = this->chunks[nodeIndex];
+    chunk.valid = true;
+    chunk.bounds = bounds;
+    chunk.geomError = hf.GeomError;
+    chunk.maxHeight = 0;
+    const int cellSizeX = hf.SizeX / nodeChunk::NumCells;
+    const int cellSizeY = hf.SizeY / nodeChunk::NumCells;
+    for (int cx = 0; cx < nodeChunk::NumCells; cx++) {
+        for (int cy = 0; cy < nodeChunk::NumCells; cy++) {
+            uint8_t minHeight = 0xFF;
+            for (int x = 0; x < cellSizeX; x++) {
+                const uint8_t* column = hf.Heights + (hf.OffsetX + cx*cellSizeX + x) * hf.ArraySizeY + hf.OffsetY + cy*cellSizeY;
+                for (int y = 0; y < cellSizeY; y++) {
+                    minHeight = column[y] < minHeight ? column[y] : minHeight;
+                    chunk.maxHeight = column[y] > chunk.maxHeight ? column[y] : chunk.maxHeight;
+                }
+            }
+            chunk.minHeights[cx][cy] = minHeight;
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::traverse(const Camera& camera, int16_t nodeIndex, const VisBounds& bounds, int lvl, int posX, int posY) {
-    this->traverseStack.Add(nodeIndex);
+VisTree::ApplyVolume(NodeHandle handle, const VisBounds& bounds, const Volume& vol, float geomError) {
+    // like ApplyHeights, but edited columns may have holes and overhangs:
+    // the solid run from the bottom is the occluder height, the highest
+    // solid voxel is the top of the geometry
+    const int32_t nodeIndex = this->Lookup(handle);
+    if (VisNode::InvalidChild == nodeIndex) {
+        return;
+    }
+    nodeChunk& chunk = this->chunks[nodeIndex];
+    chunk.valid = true;
+    chunk.bounds = bounds;
+    chunk.geomError = geomError;
+    chunk.maxHeight = 0;
+    const int cellSizeX = vol.SizeX / nodeChunk::NumCells;
+    const int cellSizeY = vol.SizeY / nodeChunk::NumCells;
+    for (int cx = 0; cx < nodeChunk::NumCells; cx++) {
+        for (int cy = 0; cy < nodeChunk::NumCells; cy++) {
+            int minHeight = 0xFF;
+            for (int x = 0; x < cellSizeX; x++) {
+                for (int y = 0; y < cellSizeY; y++) {
+                    const int ix = vol.OffsetX + cx*cellSizeX + x;
+                    const int iy = vol.OffsetY + cy*cellSizeY + y;
+                    const uint8_t* column = vol.Blocks + (ix * vol.ArraySizeY + iy) * vol.ArraySizeZ;
+                    int solid = 0;
+                    while ((solid < vol.ArraySizeZ) && (0 != column[solid])) {
+                        solid++;
+                    }
+                    int top = vol.ArraySizeZ;
+                    while ((top > 0) && (0 == column[top - 1])) {
+                        top--;
+                    }
+                    minHeight = solid < minHeight ? solid : minHeight;
+                    chunk.maxHeight = top > chunk.maxHeight ? top : chunk.maxHeight;
+                }
+            }
+            chunk.minHeights[cx][cy] = minHeight;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::MarkDirty(const VisBounds& area) {
+    for (const rootSlot& root : this->roots) {
+        if (VisNode::InvalidChild != root.Node) {
+            const VisBounds bounds(root.CellX * RootSize, (root.CellX + 1) * RootSize,
+                                   root.CellY * RootSize, (root.CellY + 1) * RootSize);
+            this->markDirty(root.Node, bounds, area);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::markDirty(int32_t nodeIndex, const VisBounds& bounds, const VisBounds& area) {
+    // a chunk's geom depends on the voxels in its bounds plus a 1-voxel
+    // apron (at the chunk's LOD), every LOD touching the area is marked,
+    // nodes without geom or with a pending job pick up the edit when
+    // their job runs
+    const int64_t apron = (bounds.x1 - bounds.x0) / this->ChunkSize;
+    if (((bounds.x0 - apron) >= area.x1) || ((bounds.x1 + apron) <= area.x0) ||
+        ((bounds.y0 - apron) >= area.y1) || ((bounds.y1 + apron) <= area.y0)) {
+        return;
+    }
+    // the subtree's cached traversal result is outdated
+    this->cache[nodeIndex].stable = false;
+    // until the chunk is regenerated, its heights are unknown: it
+    // can't occlude anything, and nothing can occlude it
+    nodeChunk& chunk = this->chunks[nodeIndex];
+    if (chunk.valid) {
+        chunk.maxHeight = Config::ChunkSizeZ + 2;
+        for (int cx = 0; cx < nodeChunk::NumCells; cx++) {
+            for (int cy = 0; cy < nodeChunk::NumCells; cy++) {
+                chunk.minHeights[cx][cy] = 0;
+            }
+        }
+    }
     VisNode& node = this->NodeAt(nodeIndex);
-    float rho = this->ScreenSpaceError(bounds, lvl, posX, posY);
-    const float tau = 15.0f;
-    if ((rho <= tau) || (0 == lvl)) {
-        this->gatherDrawNode(camera, nodeIndex, lvl, bounds);
+    if (node.HasGeom() && !node.WaitsForGeom() && !(node.flags & VisNode::Dirty)) {
+        node.flags |= VisNode::Dirty;
+        this->NumDirtyNodes++;
+        this->numSideEffects++;
     }
-    else {
-        if (node.IsLeaf()) {
-            this->Split(nodeIndex);
-        }
-        const int halfX = (bounds.x1 - bounds.x0)/2;
-        const int halfY = (bounds.y1 - bounds.y0)/2;
-        for (int x = 0; x < 2; x++) {
-            for (int y = 0; y < 2; y++) {
-                VisBounds childBounds;
-                childBounds.x0 = bounds.x0 + x*halfX;
-                childBounds.x1 = childBounds.x0 + halfX;
-                childBounds.y0 = bounds.y0 + y*halfY;
-                childBounds.y1 = childBounds.y0 + halfY;
-                const int childIndex = (y<<1)|x;
-                this->traverse(camera, node.childs[childIndex], childBounds, lvl-1, posX, posY);
+    if (!node.IsLeaf()) {
+        const int64_t halfX = (bounds.x1 - bounds.x0)/2;
+        const int64_t halfY = (bounds.y1 - bounds.y0)/2;
+        for (int childIndex = 0; childIndex < VisNode::NumChilds; childIndex++) {
+            VisBounds cb;
+            cb.x0 = bounds.x0 + (childIndex & 1)*halfX;
+            cb.x1 = cb.x0 + halfX;
+            cb.y0 = bounds.y0 + (childIndex >> 1)*halfY;
+            cb.y1 = cb.y0 + halfY;
+            this->markDirty(node.Child(childIndex), cb, area);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::NumStaleDrawNodes() const {
+    int num = 0;
+    for (int32_t nodeIndex : this->drawNodes) {
+        const VisNode& node = this->nodes[nodeIndex];
+        if (node.flags & (VisNode::Dirty|VisNode::GeomPending)) {
+            num++;
+        }
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::NumLevels() const {
+    return this->numLevels;
+}
+
+//------------------------------------------------------------------------------
+int
+VisTree::FrameIndex() const {
+    return this->frameIndex;
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::updateCoherence(const Camera& camera) {
+    // measure how far the camera moved and rotated since the reference
+    // pose, all cached margins are relative to that pose; if the camera
+    // strayed too far, start over with a new reference pose
+    const float maxRefDist = 64.0f;
+    const float maxRefAngle = 0.25f;
+    // (rebasing the camera origin changes Model but not the world position,
+    // this counts as movement because the occlusion buffer is origin-relative)
+    const glm::dvec3 worldPos = camera.WorldPos();
+    this->cameraMoved = (worldPos != this->prevPos) || (camera.Model != this->prevModel) || (camera.Proj != this->refProj);
+    this->prevPos = worldPos;
+    this->prevModel = camera.Model;
+    this->moveDist = float(glm::length(worldPos - this->refPos));
+    float trace = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        trace += camera.Model[i].x * this->refModel[i].x +
+                 camera.Model[i].y * this->refModel[i].y +
+                 camera.Model[i].z * this->refModel[i].z;
+    }
+    this->moveAngle = glm::acos(glm::clamp((trace - 1.0f) * 0.5f, -1.0f, 1.0f));
+    if ((this->refEpoch < 0) ||
+        (camera.Proj != this->refProj) ||
+        (this->moveDist > maxRefDist) ||
+        (this->moveAngle > maxRefAngle)) {
+
+        this->refEpoch++;
+        this->refPos = worldPos;
+        this->refModel = camera.Model;
+        this->refProj = camera.Proj;
+        this->moveDist = 0.0f;
+        this->moveAngle = 0.0f;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+VisTree::canReuse(int32_t nodeIndex) const {
+    // a box at distance r moves at most r*angle relative to the
+    // frustum planes when the camera rotates
+    const nodeCache& c = this->cache[nodeIndex];
+    if ((c.frame != (this->frameIndex - 1)) || !c.stable) {
+        return false;
+    }
+    if (!this->cameraMoved) {
+        return true;
+    }
+    const float movement = this->moveDist + (c.radius + this->moveDist) * this->moveAngle;
+    return (c.epoch == this->refEpoch) && (movement < c.margin);
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::reuseSubtree(int32_t nodeIndex) {
+    nodeCache& c = this->cache[nodeIndex];
+    const int32_t start = this->drawNodes.Size();
+    for (int i = 0; i < c.drawCount; i++) {
+        this->drawNodes.Add(this->prevDrawNodes[c.drawStart + i]);
+    }
+    c.drawStart = start;
+    c.frame = this->frameIndex;
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::traverse(const Camera& camera, int32_t rootIndex, const VisBounds& rootBounds, int rootLvl, int64_t posX, int64_t posY) {
+    // depth-first traversal with an explicit stack, children are
+    // visited in the same order as by the original recursive traversal,
+    // stable subtrees from the previous frame are copied instead of
+    // traversed (see updateCoherence)
+    const float tau = this->LodTau;
+    this->traverseStack.Clear();
+    this->traversePath.Clear();
+    BoxBatch boxes;
+    float visMargins[BoxBatch::MaxNumBoxes];
+    boxes.Add(rootBounds.x0 - this->originX, rootBounds.x1 - this->originX, 0, Config::ChunkSizeZ,
+              rootBounds.y0 - this->originY, rootBounds.y1 - this->originY);
+    uint32_t visMask = camera.BoxesVisible(boxes, visMargins);
+    this->traverseStack.Add(traverseItem(rootIndex, rootLvl, rootBounds, 0 != (visMask & 1), visMargins[0]));
+    while (!this->traverseStack.Empty()) {
+        const traverseItem item = this->traverseStack.PopBack();
+        const int32_t nodeIndex = item.NodeIndex;
+        if (item.Post) {
+            this->finishInnerNode(nodeIndex, item.LodMargin, item.SideEffects);
+            continue;
+        }
+        const int lvl = item.Level;
+        const VisBounds& bounds = item.Bounds;
+
+        // the path holds the current node and all its parents
+        while (this->traversePath.Size() > (rootLvl - lvl)) {
+            this->traversePath.PopBack();
+        }
+        this->traversePath.Add(nodeIndex);
+
+        if (this->TemporalCoherence && this->canReuse(nodeIndex)) {
+            if (!this->ValidateCoherence) {
+                this->reuseSubtree(nodeIndex);
+                this->NumReusedNodes++;
+                continue;
+            }
+            else if (VisNode::InvalidChild == this->validateNode) {
+                // evaluate anyway and compare the result when done
+                this->validateNode = nodeIndex;
+                this->validatePrevStart = this->cache[nodeIndex].drawStart;
+                this->validatePrevCount = this->cache[nodeIndex].drawCount;
+            }
+        }
+        this->NumVisitedNodes++;
+        const int sideEffects = this->numSideEffects;
+        this->cache[nodeIndex].drawStart = this->drawNodes.Size();
+
+        // the distance the camera can move before the LOD decision flips
+        // (rho = c/D, so D*|1-rho/tau| is the distance to where rho == tau),
+        // minus slack for the integer viewer position
+        float rho = this->ScreenSpaceError(bounds, this->GeomError(nodeIndex, lvl), posX, posY);
+        const float D = MinDist(posX, posY, bounds) + 1.0f;
+        float lodMargin = D * glm::abs(1.0f - rho/tau) - 3.0f;
+        bool refine = (rho > tau) && (0 != lvl);
+        bool deferSplit = false;
+        if (refine) {
+            if (this->NodeAt(nodeIndex).IsLeaf()) {
+                if ((1 == this->traversePath.Size()) && !this->NodeAt(nodeIndex).HasGeom()) {
+                    // a new root first waits for its own coarse geom, which
+                    // then is the placeholder while the children come in
+                    deferSplit = true;
+                }
+                else if (this->Split(nodeIndex)) {
+                    // the children use this node as placeholder, not the parent
+                    if (this->traversePath.Size() > 1) {
+                        this->releaseParentPlaceholder(nodeIndex);
+                    }
+                }
+                else {
+                    // node budget exhausted
+                    deferSplit = true;
+                }
+                if (deferSplit) {
+                    // draw at a coarser LOD than wanted, try again next frame
+                    refine = false;
+                    lodMargin = 0.0f;
+                }
+            }
+            else {
+                // a merge of this inner node was started but is cancelled,
+                // drop the pending or already arrived geom unless the
+                // children still depend on it
+                VisNode& node = this->NodeAt(nodeIndex);
+                if (node.WaitsForGeom()) {
+                    node.flags &= ~VisNode::GeomPending;
+                    this->numSideEffects++;
+                }
+                if (0 == node.PlaceholderRefs()) {
+                    this->FreeGeoms(nodeIndex);
+                }
+            }
+        }
+        if (!refine) {
+            if ((rho > tau) && !deferSplit) {
+                // the most detailed level is drawn no matter what
+                lodMargin = 1.0e30f;
+            }
+            bool visible = item.Visible;
+            float visMargin = item.VisMargin;
+            bool occluded = false;
+            if (visible && this->OcclusionCulling) {
+                // the occlusion result may change with any camera movement
+                visMargin = 0.0f;
+                occluded = this->nodeOccluded(nodeIndex, bounds);
+                visible = !occluded;
+            }
+            bool stable = this->gatherDrawNode(nodeIndex, lvl, bounds, visible);
+            nodeCache& c = this->cache[nodeIndex];
+            c.numOccluded = occluded ? 1 : 0;
+            c.frame = this->frameIndex;
+            c.epoch = this->refEpoch;
+            c.drawCount = this->drawNodes.Size() - c.drawStart;
+            c.radius = MaxDist(camera.WorldPos(), bounds);
+            c.stable = stable && !deferSplit && (sideEffects == this->numSideEffects);
+            // margins are measured from the current pose, rebase them to the reference pose
+            float margin = lodMargin < visMargin ? lodMargin : visMargin;
+            c.margin = margin - (this->moveDist + c.radius * this->moveAngle);
+            if (nodeIndex == this->validateNode) {
+                this->validateSubtree(nodeIndex, sideEffects);
+            }
+        }
+        else {
+            // finish the node after all children are done
+            this->traverseStack.Add(traverseItem(nodeIndex, lodMargin - this->moveDist, sideEffects));
+            const VisNode& node = this->NodeAt(nodeIndex);
+            const int64_t halfX = (bounds.x1 - bounds.x0)/2;
+            const int64_t halfY = (bounds.y1 - bounds.y0)/2;
+            // frustum-test all children in one batch, child i is box i
+            VisBounds childBounds[VisNode::NumChilds];
+            boxes.Num = 0;
+            for (int childIndex = 0; childIndex < VisNode::NumChilds; childIndex++) {
+                VisBounds& cb = childBounds[childIndex];
+                cb.x0 = bounds.x0 + (childIndex & 1)*halfX;
+                cb.x1 = cb.x0 + halfX;
+                cb.y0 = bounds.y0 + (childIndex >> 1)*halfY;
+                cb.y1 = cb.y0 + halfY;
+                boxes.Add(cb.x0 - this->originX, cb.x1 - this->originX, 0, Config::ChunkSizeZ,
+                          cb.y0 - this->originY, cb.y1 - this->originY);
+            }
+            visMask = camera.BoxesVisible(boxes, visMargins);
+            // push in reverse order, so that child 0 is popped first
+            for (int x = 1; x >= 0; x--) {
+                for (int y = 1; y >= 0; y--) {
+                    const int childIndex = (y<<1)|x;
+                    this->traverseStack.Add(traverseItem(node.Child(childIndex), lvl-1, childBounds[childIndex],
+                        0 != (visMask & (1<<childIndex)), visMargins[childIndex]));
+                }
             }
         }
     }
-    this->traverseStack.PopBack();
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::gatherDrawNode(const Camera& camera, int16_t nodeIndex, int lvl, const VisBounds& bounds) {
+VisTree::finishInnerNode(int32_t nodeIndex, float lodMargin, int sideEffects) {
+    // the subtree is stable if nothing happened in it and
+    // all children are stable
+    const VisNode& node = this->NodeAt(nodeIndex);
+    nodeCache& c = this->cache[nodeIndex];
+    c.frame = this->frameIndex;
+    c.epoch = this->refEpoch;
+    c.drawCount = this->drawNodes.Size() - c.drawStart;
+    bool stable = sideEffects == this->numSideEffects;
+    float margin = lodMargin;
+    float radius = 0.0f;
+    c.numOccluded = 0;
+    for (int i = 0; i < VisNode::NumChilds; i++) {
+        const nodeCache& cc = this->cache[node.Child(i)];
+        c.numOccluded += cc.numOccluded;
+        stable &= cc.stable;
+        margin = cc.margin < margin ? cc.margin : margin;
+        radius = cc.radius > radius ? cc.radius : radius;
+    }
+    c.stable = stable;
+    c.margin = margin;
+    c.radius = radius;
+    if (nodeIndex == this->validateNode) {
+        this->validateSubtree(nodeIndex, sideEffects);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VisTree::validateSubtree(int32_t nodeIndex, int sideEffects) {
+    // the subtree would have been reused, check that the full
+    // evaluation didn't change anything
+    const nodeCache& c = this->cache[nodeIndex];
+    bool valid = (sideEffects == this->numSideEffects) && (c.drawCount == this->validatePrevCount);
+    for (int i = 0; valid && (i < c.drawCount); i++) {
+        valid = this->drawNodes[c.drawStart + i] == this->prevDrawNodes[this->validatePrevStart + i];
+    }
+    if (!valid) {
+        Log::Warn("VisTree: temporal coherence mismatch in node %d\n", nodeIndex);
+        this->NumCoherenceErrors++;
+    }
+    this->validateNode = VisNode::InvalidChild;
+}
+
+//------------------------------------------------------------------------------
+bool
+VisTree::gatherDrawNode(int32_t nodeIndex, int lvl, const VisBounds& bounds, bool visible) {
     VisNode& node = this->NodeAt(nodeIndex);
 
-    // FIXME FIXME FIXME: this code needs a thorough cleanup, esp gathering
-    // and releasing the parent/child node placeholder geoms
+    // while a node waits for its geom, its children (when merging) or
+    // its parent (when splitting) are drawn as placeholder, a parent
+    // geom is released once no child depends on it any longer
 
     bool needsPlaceholder = false;
-    if (camera.BoxVisible(bounds.x0, bounds.x1, 0, Config::ChunkSizeZ, bounds.y0, bounds.y1)) {
-        if (!node.HasEmptyGeom() && node.NeedsGeom()) {
-            // enqueue a new geom-generation job
-            node.flags |= VisNode::GeomPending;
+    bool remeshing = false;
+    if (visible) {
+        if (node.NeedsGeom() || node.NeedsRemesh()) {
+            // enqueue a new geom-generation job, an edited node keeps
+            // drawing its old geom until the new one arrives
+            if (node.HasGeom()) {
+                this->NumRemeshJobs++;
+            }
+            node.flags = (node.flags | VisNode::GeomPending) & ~VisNode::Dirty;
             glm::vec3 scale = Scale(bounds);
-            glm::vec3 trans = Translation(bounds);
-            this->geomGenJobs.Add(GeomGenJob(nodeIndex, lvl, bounds, scale, trans));
-            needsPlaceholder = true;
+            glm::dvec3 trans = Translation(bounds);
+            this->geomGenJobs.Add(GeomGenJob(this->Handle(nodeIndex), lvl, bounds, scale, trans, this->frameIndex));
+            this->numSideEffects++;
         }
-        else if (node.WaitsForGeom()) {
-            needsPlaceholder = true;
+        if (node.WaitsForGeom()) {
+            remeshing = node.HasGeom();
+            needsPlaceholder = !remeshing;
         }
         if (needsPlaceholder) {
             // prefer child nodes as placeholder
-            if ((VisNode::InvalidChild != node.childs[0]) &&
-                (VisNode::InvalidGeom != this->NodeAt(node.childs[0]).geoms[0])) {
+            if (!node.IsLeaf() &&
+                (VisNode::InvalidGeom != this->NodeAt(node.Child(0)).geom)) {
                 for (int i = 0; i < VisNode::NumChilds; i++) {
-                    this->drawNodes.Add(node.childs[i]);
+                    this->drawNodes.Add(node.Child(i));
                 }
             }
             // otherwise check parent node as placeholder
-            else if ((this->traverseStack.Size() > 1) &&
-                     (VisNode::InvalidGeom != this->NodeAt(this->traverseStack[this->traverseStack.Size()-2]).geoms[0]))
+            else if ((this->traversePath.Size() > 1) &&
+                     (VisNode::InvalidGeom != this->NodeAt(this->traversePath[this->traversePath.Size()-2]).geom))
             {
-                this->drawNodes.Add(this->traverseStack[this->traverseStack.Size()-2]);
+                this->drawNodes.Add(this->traversePath[this->traversePath.Size()-2]);
             }
         }
         else {
@@ -199,77 +1074,93 @@ VisTree::gatherDrawNode(const Camera& camera, int16_t nodeIndex, int lvl, const
         if (!node.IsLeaf()) {
             this->Merge(nodeIndex);
         }
-        // free any parent node geoms
-        // FIXME: doing this each time is terrible!
-        int numParents = this->traverseStack.Size() - 2;    // FIXME: this should be -1? but this leaks geoms :/
-        for (int i = 0; i < numParents; i++) {
-            this->FreeGeoms(this->traverseStack[i]);
+        // the parent's geom is no longer needed by this node
+        if (this->traversePath.Size() > 1) {
+            this->releaseParentPlaceholder(nodeIndex);
         }
     }
+    return !needsPlaceholder && !remeshing;
 }
 
 //------------------------------------------------------------------------------
 void
-VisTree::ApplyGeoms(int16_t nodeIndex, int16_t* geoms, int numGeoms) {
+VisTree::ApplyGeoms(NodeHandle handle, int32_t geom) {
+    const int32_t nodeIndex = this->Lookup(handle);
+    if (VisNode::InvalidChild == nodeIndex) {
+        // the node was merged away while its geom was generated
+        if (geom >= 0) {
+            this->freeGeoms.Add(geom);
+        }
+        return;
+    }
     VisNode& node = this->NodeAt(nodeIndex);
     if (node.WaitsForGeom()) {
-        for (int i = 0; i < VisNode::NumGeoms; i++) {
-            o_assert_dbg(VisNode::InvalidGeom == node.geoms[i]);
-            if (i < numGeoms) {
-                node.geoms[i] = geoms[i];
-            }
-            else {
-                node.geoms[i] = VisNode::InvalidGeom;
-            }
+        if (!node.HasGeom()) {
+            node.geom = geom;
+        }
+        else if (VisNode::InvalidGeom != geom) {
+            // a regenerated edited chunk replaces the old geom
+            this->FreeGeoms(nodeIndex);
+            node.geom = geom;
+        }
+        else {
+            // regeneration failed, keep the old geom and retry later
+            node.flags |= VisNode::Dirty;
         }
         node.flags &= ~VisNode::GeomPending;
     }
-    else {
+    else if (geom >= 0) {
         // if the node didn't actually wait for geoms any longer,
         // immediately kill the geoms
-        for (int i = 0; i < numGeoms; i++) {
-            o_assert_dbg(VisNode::InvalidGeom != geoms[i]);
-            this->freeGeoms.Add(geoms[i]);
-        }
+        this->freeGeoms.Add(geom);
     }
 }
 
 //------------------------------------------------------------------------------
 float
-VisTree::MinDist(int x, int y, const VisBounds& bounds) {
-    int dx;
-    int dx0 = x - bounds.x0;
-    int dx1 = bounds.x1 - x;
+VisTree::MinDist(int64_t x, int64_t y, const VisBounds& bounds) {
+    // squared in double, 64-bit coordinates would overflow
+    double dx;
+    int64_t dx0 = x - bounds.x0;
+    int64_t dx1 = bounds.x1 - x;
     if ((dx0 >= 0) && (dx1 >= 0)) {
-        dx = 0;     // inside
+        dx = 0.0;   // inside
     }
     else {
-        dx0 *= dx0;
-        dx1 *= dx1;
-        dx = dx0<dx1 ? dx0:dx1;
+        dx = double(glm::min(glm::abs(dx0), glm::abs(dx1)));
+        dx *= dx;
     }
 
-    int dy;
-    int dy0 = y - bounds.y0;
-    int dy1 = bounds.y1 - y;
+    double dy;
+    int64_t dy0 = y - bounds.y0;
+    int64_t dy1 = bounds.y1 - y;
     if ((dy0 >= 0) && (dy1 >= 0)) {
-        dy = 0;
+        dy = 0.0;
     }
     else {
-        dy0 *= dy0;
-        dy1 *= dy1;
-        dy = dy0<dy1 ? dy0:dy1;
+        dy = double(glm::min(glm::abs(dy0), glm::abs(dy1)));
+        dy *= dy;
     }
-    float d = glm::sqrt(dx+dy);
+    float d = float(glm::sqrt(dx+dy));
     return d;
 }
 
+//------------------------------------------------------------------------------
+float
+VisTree::MaxDist(const glm::dvec3& pos, const VisBounds& bounds) {
+    // note: bounds x/y are world x/z, the chunk's height is world y
+    const double dx = glm::max(glm::abs(pos.x - bounds.x0), glm::abs(pos.x - bounds.x1));
+    const double dy = glm::max(glm::abs(pos.y), glm::abs(pos.y - Config::ChunkSizeZ));
+    const double dz = glm::max(glm::abs(pos.z - bounds.y0), glm::abs(pos.z - bounds.y1));
+    return float(glm::sqrt(dx*dx + dy*dy + dz*dz));
+}
+
 //------------------------------------------------------------------------------
 VisBounds
-VisTree::Bounds(int lvl, int x, int y) {
-    o_assert_dbg(lvl <= NumLevels);
-    // level 0 is most detailed, level == NumLevels is the root node
-    int dim = (1<<lvl) * Config::ChunkSizeXY;
+VisTree::Bounds(int lvl, int64_t x, int64_t y, int chunkSize) {
+    o_assert_dbg(lvl <= MaxNumLevels);
+    // level 0 is most detailed, level == NumLevels() is the root node
+    int64_t dim = int64_t(chunkSize) << lvl;
     VisBounds bounds;
     bounds.x0 = (x>>lvl) * dim;
     bounds.x1 = bounds.x0 + dim;
@@ -279,17 +1170,17 @@ VisTree::Bounds(int lvl, int x, int y) {
 }
 
 //------------------------------------------------------------------------------
-glm::vec3
-VisTree::Translation(const VisBounds& bounds) {
-    return glm::vec3(bounds.x0 - (bounds.x1-bounds.x0)/Config::ChunkSizeXY,
-                     bounds.y0 - (bounds.y1-bounds.y0)/Config::ChunkSizeXY,
-                     0.0f);
+glm::dvec3
+VisTree::Translation(const VisBounds& bounds) const {
+    return glm::dvec3(double(bounds.x0 - (bounds.x1-bounds.x0)/this->ChunkSize),
+                      double(bounds.y0 - (bounds.y1-bounds.y0)/this->ChunkSize),
+                      0.0);
 }
 
 //------------------------------------------------------------------------------
 glm::vec3
-VisTree::Scale(const VisBounds& bounds) {
-    return glm::vec3((bounds.x1-bounds.x0)/Config::ChunkSizeXY,
-                     (bounds.y1-bounds.y0)/Config::ChunkSizeXY,
+VisTree::Scale(const VisBounds& bounds) const {
+    return glm::vec3(float((bounds.x1-bounds.x0)/this->ChunkSize),
+                     float((bounds.y1-bounds.y0)/this->ChunkSize),
                      1.0f);
 }
@@ -3,77 +3,282 @@
 /** 
     @class VisTree
     @brief sparse quad-tree for LOD and visibility detection
+
+    The world is covered by a toroidal grid of RootGridDim x RootGridDim
+    quad-tree roots centered on the camera; roots scrolling out of the
+    grid are recycled (with their subtrees and geoms) for the cells
+    scrolling in, so the world is infinite.
 */
 #include "Core/Types.h"
 #include "Core/Containers/Array.h"
+#include "Core/Time/Duration.h"
 #include "glm/vec3.hpp"
-#include "GeomPool.h"
-#include "GeomMesher.h"
+#include "glm/mat4x4.hpp"
+#include "Config.h"
 #include "VisNode.h"
 #include "VisBounds.h"
 #include "Camera.h"
+#include "HeightField.h"
+#include "Volume.h"
+#include "OcclusionBuffer.h"
 
 class VisTree {
 public:
-    /// number of levels, the most detailed level is 0
-    static const int NumLevels = 8;
+    /// size of a root node in voxels, the same for all chunk sizes
+    static const int RootSize = (1<<8) * Config::ChunkSizeXY;
+    /// max number of levels (with the smallest chunks), the most detailed level is 0
+    static const int MaxNumLevels = 9;
+    /// number of roots along each side of the root grid (odd, so the camera's root is in the center)
+    static const int RootGridDim = 3;
+    static const int NumRoots = RootGridDim * RootGridDim;
 
     /// setup the vistree
     void Setup(int displayWidth, float fov);
     /// discard the vistree
     void Discard();
 
+    /// chunk size along x and y in voxels (set before Setup), the number of levels depends on it
+    int ChunkSize = Config::ChunkSizeXY;
+    /// number of levels below the roots (valid after Setup)
+    int NumLevels() const;
+    /// max number of nodes, 0 means only limited by the handle range (set before Setup)
+    int MaxNumNodes = 0;
+    /// smallest node budget, the root grid needs a node block for every root
+    static const int MinNumNodes = NumRoots * VisNode::NumChilds;
+    /// LOD threshold, nodes with a larger screen-space error (in pixels) are refined,
+    /// a bound from level 4 up, below it rests on the generator's estimated geometric error
+    float LodTau = 15.0f;
+    /// initial capacity of the node store, it grows on demand
+    static const int InitialNumNodes = 1024;
+
     /// get node by index
-    VisNode& NodeAt(int16_t nodeIndex);
-    /// allocate and init a node
-    int16_t AllocNode();
-    /// free any geoms in a node (non-recursive)
-    void FreeGeoms(int16_t nodeIndex);
-    /// split a node (create child nodes)
-    void Split(int16_t nodeIndex);
+    VisNode& NodeAt(int32_t nodeIndex);
+    /// allocate and init a block of 4 sibling nodes, return index of first node (InvalidChild if out of nodes)
+    int32_t AllocNodeBlock();
+    /// free a block of 4 sibling nodes
+    void FreeNodeBlock(int32_t firstNodeIndex);
+    /// number of free nodes
+    int NumFreeNodes() const;
+    /// number of nodes in the node store (used and free)
+    int NumNodes() const;
+    /// memory used by the node store in bytes
+    int NodeMemory() const;
+    /// report the node store, job queue and traversal memory to MemTrack
+    void TrackMemory();
+
+    /// a 32-bit generational node handle, for node references which
+    /// may outlive the node (e.g. geom generation jobs), the low bits
+    /// are the node index, the high bits the generation of its block
+    typedef uint32_t NodeHandle;
+    static const NodeHandle InvalidHandle = 0xFFFFFFFF;
+    static const int HandleIndexBits = 24;
+    static const uint32_t HandleIndexMask = (1<<HandleIndexBits) - 1;
+    /// get handle of a node
+    NodeHandle Handle(int32_t nodeIndex) const;
+    /// resolve a handle to a node index, InvalidChild if the node has been freed since
+    int32_t Lookup(NodeHandle handle) const;
+    /// free the geom chain of a node (non-recursive)
+    void FreeGeoms(int32_t nodeIndex);
+    /// split a node (create child nodes), return false if out of nodes
+    bool Split(int32_t nodeIndex);
+    /// check tree invariants (node blocks, geoms, placeholder refs), slow
+    bool CheckInvariants() const;
     /// merge a node, frees all child nodes recursively
-    void Merge(int16_t nodeIndex);
-    /// compute the screen-space error for a bounding rect and viewer pos x,y
-    float ScreenSpaceError(const VisBounds& bounds, int lvl, int x, int y) const;
+    void Merge(int32_t nodeIndex);
+    /// compute the screen-space error for a bounding rect with geometric error and viewer pos x,y
+    float ScreenSpaceError(const VisBounds& bounds, float geomError, int64_t x, int64_t y) const;
+    /// get a node's geometric error (measured, estimated from children, or the 1<<lvl default)
+    float GeomError(int32_t nodeIndex, int lvl) const;
+    /// use measured geometric errors for the screen-space error (default true)
+    bool UseGeomError = true;
     /// traverse the tree, deciding which nodes to render
     void Traverse(const Camera& camera);
-    /// apply geoms to a node
-    void ApplyGeoms(int16_t nodeIndex, int16_t* geoms, int numGeoms);
-    /// internal, recursive traversal method
-    void traverse(const Camera& camera, int16_t nodeIndex, const VisBounds& bounds, int lvl, int x, int y);
-    /// gather a drawable node, prepare for drawing if needed
-    void gatherDrawNode(const Camera& camera, int16_t nodeIndex, int lvl, const VisBounds& bounds);
+    /// reuse stable subtrees from the previous traversal (default true)
+    bool TemporalCoherence = true;
+    /// evaluate all nodes and check that reused subtrees would not have changed (slow)
+    bool ValidateCoherence = false;
+    /// cull leaf nodes hidden behind the terrain (default true)
+    bool OcclusionCulling = true;
+    /// apply a geom chain to a node (InvalidGeom means generation failed, retry later)
+    void ApplyGeoms(NodeHandle node, int32_t geom);
+    /// record a node's terrain heights and geometric error, used for LOD and occlusion culling
+    void ApplyHeights(NodeHandle node, const VisBounds& bounds, const HeightField& heightField);
+    /// same as ApplyHeights for a chunk generated as volume (e.g. with voxel edits applied)
+    void ApplyVolume(NodeHandle node, const VisBounds& bounds, const Volume& volume, float geomError);
+    /// mark all nodes whose chunk (including apron) touches an edited area for regeneration
+    void MarkDirty(const VisBounds& area);
+    /// number of draw nodes still showing geometry from before an edit
+    int NumStaleDrawNodes() const;
+    /// number of traversals so far
+    int FrameIndex() const;
+    /// internal, iterative traversal method
+    void traverse(const Camera& camera, int32_t nodeIndex, const VisBounds& bounds, int lvl, int64_t x, int64_t y);
+    /// gather a drawable node, prepare for drawing if needed, return false if node is in flux
+    bool gatherDrawNode(int32_t nodeIndex, int lvl, const VisBounds& bounds, bool visible);
+    /// update camera movement since the reference pose
+    void updateCoherence(const Camera& camera);
+    /// return true if the node's cached subtree result from last frame is still valid
+    bool canReuse(int32_t nodeIndex) const;
+    /// copy a subtree's draw nodes from the previous frame
+    void reuseSubtree(int32_t nodeIndex);
+    /// finish an inner node after all its children have been traversed
+    void finishInnerNode(int32_t nodeIndex, float lodMargin, int sideEffects);
+    /// move the root grid with the camera, recycle roots which scrolled out
+    void updateRoots(const Camera& camera);
+    /// remove queued geom jobs of nodes which no longer wait for them
+    void purgeJobs();
+    /// check a reused subtree candidate against the full evaluation
+    void validateSubtree(int32_t nodeIndex, int sideEffects);
+    /// release a node's dependency on its parent's geom, frees the parent geom when no child depends on it
+    void releaseParentPlaceholder(int32_t nodeIndex);
+    /// check invariants of a subtree, return number of node blocks in the subtree
+    int checkSubtree(int32_t nodeIndex, bool merging, Oryol::Array<int32_t>& geoms, bool& valid) const;
+    /// rasterize last frame's draw nodes into the occlusion buffer
+    void updateOcclusion(const Camera& camera);
+    /// test a node against the occlusion buffer
+    bool nodeOccluded(int32_t nodeIndex, const VisBounds& bounds) const;
+    /// mark a subtree dirty where it touches an edited area
+    void markDirty(int32_t nodeIndex, const VisBounds& bounds, const VisBounds& area);
     /// invalidate any child nodes (free geoms, free nodes)
-    void invalidateChildNodes(int16_t nodeIndex);
+    void invalidateChildNodes(int32_t nodeIndex);
 
     /// compute minimal distance between position and bounds
-    static float MinDist(int x, int y, const VisBounds& bounds);
+    static float MinDist(int64_t x, int64_t y, const VisBounds& bounds);
+    /// compute maximum 3D distance between position and a chunk's bounding box
+    static float MaxDist(const glm::dvec3& pos, const VisBounds& bounds);
     /// get a node's bounds
-    static VisBounds Bounds(int lvl, int x, int y);
-    /// compute translation vector for a bounds
-    static glm::vec3 Translation(const VisBounds& bounds);
+    static VisBounds Bounds(int lvl, int64_t x, int64_t y, int chunkSize);
+    /// compute world-space translation vector for a bounds
+    glm::dvec3 Translation(const VisBounds& bounds) const;
     /// compute scale vector for a bounds rect
-    static glm::vec3 Scale(const VisBounds& bounds);
+    glm::vec3 Scale(const VisBounds& bounds) const;
 
     struct GeomGenJob {
-        GeomGenJob() : NodeIndex(Oryol::InvalidIndex), Level(0) { }
-        GeomGenJob(int16_t nodeIndex, int lvl, const VisBounds& bounds, const glm::vec3& scale, const glm::vec3& trans) :
-            NodeIndex(nodeIndex), Level(lvl), Bounds(bounds), Scale(scale), Translate(trans) { }
+        GeomGenJob() : Node(InvalidHandle), Level(0) { }
+        GeomGenJob(NodeHandle node, int lvl, const VisBounds& bounds, const glm::vec3& scale, const glm::dvec3& trans, int frame) :
+            Node(node), Level(lvl), Bounds(bounds), Scale(scale), Translate(trans), Frame(frame) { }
 
-        int16_t NodeIndex;
+        NodeHandle Node;
         int Level;
         VisBounds Bounds;
         glm::vec3 Scale;
-        glm::vec3 Translate;
+        glm::dvec3 Translate;       // world space
+        int Frame = 0;              // traversal the job was queued in, see FrameIndex()
+    };
+
+    /// an entry on the explicit traversal stack
+    struct traverseItem {
+        traverseItem() : NodeIndex(VisNode::InvalidChild), Level(0) { }
+        traverseItem(int32_t nodeIndex, int lvl, const VisBounds& bounds, bool visible, float visMargin) :
+            NodeIndex(nodeIndex), Level(lvl), Bounds(bounds), Visible(visible), VisMargin(visMargin) { }
+        /// construct a post-order item, popped after the node's children
+        traverseItem(int32_t nodeIndex, float lodMargin, int sideEffects) :
+            NodeIndex(nodeIndex), Level(0), Post(true), LodMargin(lodMargin), SideEffects(sideEffects) { }
+
+        int32_t NodeIndex;
+        int Level;
+        VisBounds Bounds;
+        bool Visible = false;       // frustum test result, done for all siblings at once
+        float VisMargin = 0.0f;
+        bool Post = false;
+        float LodMargin = 0.0f;
+        int SideEffects = 0;
+    };
+
+    /// per-node result of the previous traversal, for temporal coherence
+    struct nodeCache {
+        int frame = -1;             // traversal frame the result was recorded in
+        int epoch = -1;             // reference pose epoch
+        bool stable = false;        // no splits, merges, jobs or placeholders in subtree
+        float margin = -1.0f;       // camera movement the subtree tolerates (relative to reference pose)
+        float radius = 0.0f;        // max distance of the subtree's boxes from the camera
+        int32_t drawStart = 0;      // the subtree's range in drawNodes
+        int32_t drawCount = 0;
+        int32_t numOccluded = 0;    // number of occlusion-culled leaves in subtree
+    };
+
+    /// terrain info of a node's chunk, written when its geom is generated
+    struct nodeChunk {
+        static const int NumCells = 4;
+        bool valid = false;
+        VisBounds bounds;
+        float geomError = 0.0f;
+        uint8_t maxHeight = 0;
+        uint8_t minHeights[NumCells][NumCells];     // per cell, x-major
     };
 
     float K;
-    static const int MaxNumNodes = 1024;
-    VisNode nodes[MaxNumNodes];
-    Oryol::Array<int16_t> freeNodes;
-    Oryol::Array<int16_t> drawNodes;
+    int numLevels = 0;
+    // nodes are allocated in blocks of 4 siblings, block 0 holds the root,
+    // the per-node arrays only grow (freed blocks are recycled)
+    Oryol::Array<VisNode> nodes;
+    Oryol::Array<nodeCache> cache;
+    Oryol::Array<nodeChunk> chunks;
+    Oryol::Array<uint8_t> blockGenerations;     // incremented when a block is freed
+    OcclusionBuffer occlusionBuffer;
+    struct occluderItem {
+        occluderItem() : NodeIndex(VisNode::InvalidChild), Dist(0.0f) { }
+        occluderItem(int32_t nodeIndex, float dist) : NodeIndex(nodeIndex), Dist(dist) { }
+        int32_t NodeIndex;
+        float Dist;
+    };
+    Oryol::Array<occluderItem> occluders;
+    Oryol::Array<int32_t> freeNodeBlocks;
+    Oryol::Array<int32_t> drawNodes;
+    Oryol::Array<int32_t> prevDrawNodes;
     Oryol::Array<GeomGenJob> geomGenJobs;
-    Oryol::Array<int16_t> freeGeoms;
-    Oryol::Array<int16_t> traverseStack;
-    int16_t rootNode;
+    Oryol::Array<int32_t> freeGeoms;
+    Oryol::Array<traverseItem> traverseStack;
+    Oryol::Array<int32_t> traversePath;     // current node and its parents
+    /// a root of the toroidal root grid, cell (x, y) lives in slot (x mod RootGridDim, y mod RootGridDim)
+    struct rootSlot {
+        int32_t Node = VisNode::InvalidChild;
+        int64_t CellX = 0;
+        int64_t CellY = 0;
+    };
+    rootSlot roots[NumRoots];
+    bool rootsValid = false;
+    int64_t rootCenterX = 0;        // cell of the center root
+    int64_t rootCenterY = 0;
+    // the camera's floating origin in bounds coordinates, boxes handed
+    // to the camera and occlusion buffer are relative to it
+    int64_t originX = 0;
+    int64_t originY = 0;
+
+    // temporal coherence state
+    int frameIndex = 0;
+    int refEpoch = -1;
+    glm::dvec3 refPos;
+    glm::mat4 refModel;
+    glm::mat4 refProj;
+    float moveDist = 0.0f;          // camera distance from reference pose
+    float moveAngle = 0.0f;         // camera rotation angle from reference pose
+    bool cameraMoved = true;        // camera pose differs from previous frame
+    glm::dvec3 prevPos;
+    glm::mat4 prevModel;
+    int numSideEffects = 0;         // incremented on every split, merge, geom free or job
+    int32_t validateNode = VisNode::InvalidChild;
+    int32_t validatePrevStart = 0;
+    int32_t validatePrevCount = 0;
+
+    // traversal stats
+    int NumVisitedNodes = 0;
+    int NumReusedNodes = 0;
+    int NumCoherenceErrors = 0;
+    int NumOccluders = 0;
+    int NumOccludedNodes = 0;
+    Oryol::Duration OcclusionTime;
+    int NumFailedSplits = 0;        // splits refused because the node budget is exhausted
+    int MaxUsedNodes = 0;           // high-water mark of used nodes
+    int NumRecycledRoots = 0;       // total number of roots recycled for new cells
+    int NumPurgedJobs = 0;          // total number of stale geom jobs removed from the queue
+    int NumDirtyNodes = 0;          // total number of nodes marked dirty by edits
+    int NumRemeshJobs = 0;          // total number of geom jobs for dirty nodes
+    int NumSplits = 0;              // total number of split nodes
+    int NumMerges = 0;              // total number of merged nodes (including merged children)
+
+    // bytes last reported to MemTrack
+    int64_t trackedNodes = 0;
+    int64_t trackedJobs = 0;
+    int64_t trackedTraversal = 0;
 };
@@ -0,0 +1,575 @@
+//------------------------------------------------------------------------------
+//  VoxelBench.cc
+//
+//  Microbenchmarks of the hot kernels with fixed inputs (no GPU needed):
+//
+//  - GenSimplex, GenSimplexHeightField and Meshify of 16 chunks per LOD level
+//  - full VisTree traversals (no temporal coherence) at fixed camera poses
+//  - BoxVisible and the batched BoxesVisible on a million boxes
+//  - MinDist on a million positions and node bounds
+//
+//  Each benchmark runs once to warm up and then -runs times, the report
+//  has the mean, standard deviation and minimum in ns per op and the
+//  throughput. The check value is derived from the benchmark's results,
+//  it only changes when the output of a kernel changes. With -out the
+//  results are written as JSON lines (one object per benchmark) to diff
+//  between commits. The report ends with the per-subsystem memory of
+//  the benchmark data (also written as JSON lines with -out).
+//
+//  Before the benchmarks the height field mesher is checked against
+//  stb_voxel_render: both must produce the same quads (compared as
+//  sorted vertex data) for all benchmark chunks, otherwise voxelbench
+//  fails with exit code 10.
+//
+//  -chunksize selects the chunk size of the generator, mesher and VisTree
+//  (16, 32 or 64), run it once per size to compare the kernels.
+//
+//  voxelbench [-runs n] [-filter substring] [-out file.jsonl] [-chunksize n]
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Core/Core.h"
+#include "Core/Log.h"
+#include "Core/Containers/Array.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Time/Clock.h"
+#include "VoxelGenerator.h"
+#include "GeomMesher.h"
+#include "VisTree.h"
+#include "MemTrack.h"
+#include "glm/trigonometric.hpp"
+#include "glm/common.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+using namespace Oryol;
+
+const int NumChunksPerLevel = 16;
+const int NumTraversals = 10;
+const int NumBoxes = 1000000;
+const int NumBatches = NumBoxes / BoxBatch::MaxNumBoxes;
+const int NumMinDistSamples = 1 << 16;
+const int NumMinDistOps = 1000000;
+
+static VoxelGenerator voxelGenerator;
+static GeomMesher geomMesher;
+static uint32_t seed = 1;
+static int chunkSize = Config::ChunkSizeXY;
+static int numLevels = 0;
+
+//------------------------------------------------------------------------------
+static const char*
+arg(int argc, const char** argv, const char* name, const char* def) {
+    for (int i = 1; i < (argc - 1); i++) {
+        if (0 == strcmp(argv[i], name)) {
+            return argv[i + 1];
+        }
+    }
+    return def;
+}
+
+//------------------------------------------------------------------------------
+static int
+rnd(int num) {
+    // fixed LCG so that the inputs are identical across platforms
+    seed = seed * 1664525 + 1013904223;
+    return int((seed >> 8) % uint32_t(num));
+}
+
+//------------------------------------------------------------------------------
+//  chunk inputs: the same chunks for GenSimplex and Meshify
+//
+static VisBounds chunkBounds[VisTree::MaxNumLevels][NumChunksPerLevel];
+static uint8_t* chunkBlocks[VisTree::MaxNumLevels][NumChunksPerLevel];
+static uint8_t* chunkHeights[VisTree::MaxNumLevels][NumChunksPerLevel];
+
+//------------------------------------------------------------------------------
+static void
+setupChunks() {
+    // random chunks in a 64x64 chunk area around the start position
+    seed = 1;
+    const int volumeSizeXY = voxelGenerator.VolumeSizeXY();
+    const int volumeSize = volumeSizeXY * volumeSizeXY * VoxelGenerator::VolumeSizeZ;
+    const int heightsSize = volumeSizeXY * volumeSizeXY;
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        const int64_t dim = int64_t(chunkSize) << lvl;
+        for (int i = 0; i < NumChunksPerLevel; i++) {
+            const int64_t x = 4096 + (rnd(64) - 32) * dim;
+            const int64_t y = 4096 + (rnd(64) - 32) * dim;
+            const VisBounds bounds = VisTree::Bounds(lvl, x, y, chunkSize);
+            chunkBounds[lvl][i] = bounds;
+            chunkBlocks[lvl][i] = (uint8_t*) Memory::Alloc(volumeSize);
+            Memory::Copy(voxelGenerator.GenSimplex(bounds).Blocks, chunkBlocks[lvl][i], volumeSize);
+            chunkHeights[lvl][i] = (uint8_t*) Memory::Alloc(heightsSize);
+            Memory::Copy(voxelGenerator.GenSimplexHeightField(bounds).Heights, chunkHeights[lvl][i], heightsSize);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+discardChunks() {
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        for (int i = 0; i < NumChunksPerLevel; i++) {
+            Memory::Free(chunkBlocks[lvl][i]);
+            Memory::Free(chunkHeights[lvl][i]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static int
+sumHeights() {
+    int sum = 0;
+    const int volumeSizeXY = voxelGenerator.VolumeSizeXY();
+    for (int i = 0; i < volumeSizeXY * volumeSizeXY; i++) {
+        sum += voxelGenerator.heights[i];
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchGenSimplex(int lvl, uint64_t& check) {
+    for (int i = 0; i < NumChunksPerLevel; i++) {
+        voxelGenerator.GenSimplex(chunkBounds[lvl][i]);
+        check += sumHeights();
+    }
+    return NumChunksPerLevel;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchGenSimplexHeightField(int lvl, uint64_t& check) {
+    for (int i = 0; i < NumChunksPerLevel; i++) {
+        voxelGenerator.GenSimplexHeightField(chunkBounds[lvl][i]);
+        check += sumHeights();
+    }
+    return NumChunksPerLevel;
+}
+
+//------------------------------------------------------------------------------
+static int
+meshify(uint64_t& check) {
+    GeomMesher::Result result;
+    do {
+        result = geomMesher.Meshify();
+        check += result.NumQuads;
+    }
+    while (!result.VolumeDone);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchMeshifyVolume(int lvl, uint64_t& check) {
+    Volume volume = voxelGenerator.initVolume();
+    for (int i = 0; i < NumChunksPerLevel; i++) {
+        volume.Blocks = chunkBlocks[lvl][i];
+        geomMesher.Start();
+        geomMesher.StartVolume(volume);
+        meshify(check);
+    }
+    return NumChunksPerLevel;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchMeshifyHeightField(int lvl, uint64_t& check) {
+    HeightField heightField = voxelGenerator.initHeightField();
+    for (int i = 0; i < NumChunksPerLevel; i++) {
+        heightField.Heights = chunkHeights[lvl][i];
+        geomMesher.Start();
+        geomMesher.StartHeightField(heightField);
+        meshify(check);
+    }
+    return NumChunksPerLevel;
+}
+
+//------------------------------------------------------------------------------
+//  check that the height field mesher produces the same quads as
+//  stb_voxel_render for the same chunks
+//
+struct meshQuad {
+    uint32_t data[8];       // 4 vertices of attr_vertex, attr_face
+    bool operator<(const meshQuad& rhs) const {
+        return std::lexicographical_compare(this->data, this->data + 8, rhs.data, rhs.data + 8);
+    }
+    bool operator!=(const meshQuad& rhs) const {
+        return 0 != memcmp(this->data, rhs.data, sizeof(this->data));
+    }
+};
+
+//------------------------------------------------------------------------------
+static void
+collectQuads(Array<meshQuad>& quads) {
+    quads.Clear();
+    GeomMesher::Result result;
+    do {
+        result = geomMesher.Meshify();
+        const meshQuad* src = (const meshQuad*) result.Vertices;
+        for (int i = 0; i < result.NumQuads; i++) {
+            quads.Add(src[i]);
+        }
+    }
+    while (!result.VolumeDone);
+    std::sort(quads.begin(), quads.end());
+}
+
+//------------------------------------------------------------------------------
+static bool
+checkMeshers() {
+    Array<meshQuad> volumeQuads, heightFieldQuads;
+    Volume volume = voxelGenerator.initVolume();
+    HeightField heightField = voxelGenerator.initHeightField();
+    int numMismatches = 0;
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        for (int i = 0; i < NumChunksPerLevel; i++) {
+            volume.Blocks = chunkBlocks[lvl][i];
+            geomMesher.Start();
+            geomMesher.StartVolume(volume);
+            collectQuads(volumeQuads);
+            heightField.Heights = chunkHeights[lvl][i];
+            geomMesher.Start();
+            geomMesher.StartHeightField(heightField);
+            collectQuads(heightFieldQuads);
+            bool same = volumeQuads.Size() == heightFieldQuads.Size();
+            for (int q = 0; same && (q < volumeQuads.Size()); q++) {
+                same = !(volumeQuads[q] != heightFieldQuads[q]);
+            }
+            if (!same) {
+                Log::Warn("mesher mismatch: level %d chunk %d, %d quads from volume, %d from height field\n",
+                    lvl, i, volumeQuads.Size(), heightFieldQuads.Size());
+                numMismatches++;
+            }
+        }
+    }
+    Log::Info("height field mesher vs. stb_voxel_render: %d of %d chunks match\n",
+        numLevels * NumChunksPerLevel - numMismatches, numLevels * NumChunksPerLevel);
+    return 0 == numMismatches;
+}
+
+//------------------------------------------------------------------------------
+//  traversal inputs: one converged VisTree per camera pose
+//
+struct pose {
+    double x, y, z;
+    float yaw, pitch;
+};
+static const pose poses[] = {
+    { 4096.0, 40.0, 4096.0, 0.0f, 0.0f },                   // near the ground
+    { 4096.0, 300.0, 4096.0, 0.5f, -0.6f },                 // high above, looking down
+    { 10000000.5, 48.0, -30000000.25, 2.0f, -0.1f },        // far from the world origin
+    { 4096.0, 64.0, 4096.0, 0.8f, -1.2f },                  // looking steeply down
+};
+static const int NumPoses = sizeof(poses) / sizeof(pose);
+static VisTree visTrees[NumPoses];
+static Camera cameras[NumPoses];
+static Array<int32_t> freeGeoms;
+static int32_t numGeoms = 0;
+
+//------------------------------------------------------------------------------
+static void
+setupCamera(Camera& camera, const pose& p) {
+    camera.Setup(glm::dvec3(p.x, p.y, p.z), glm::radians(45.0f), 800, 600, 0.1f, 10000.0f);
+    camera.MoveRotate(glm::vec3(), glm::vec2(p.yaw, p.pitch));
+}
+
+//------------------------------------------------------------------------------
+static void
+converge(VisTree& visTree, const Camera& camera) {
+    // traverse and complete all geom jobs with dummy geoms (but real
+    // heights for occlusion culling) until the tree doesn't change
+    int numIdle = 0;
+    for (int i = 0; (i < 1000) && (numIdle < 2); i++) {
+        visTree.Traverse(camera);
+        numIdle = visTree.geomGenJobs.Empty() ? numIdle + 1 : 0;
+        while (!visTree.geomGenJobs.Empty()) {
+            const VisTree::GeomGenJob job = visTree.geomGenJobs.PopBack();
+            visTree.ApplyHeights(job.Node, job.Bounds, voxelGenerator.GenSimplexHeightField(job.Bounds));
+            visTree.ApplyGeoms(job.Node, freeGeoms.Empty() ? numGeoms++ : freeGeoms.PopBack());
+        }
+        while (!visTree.freeGeoms.Empty()) {
+            freeGeoms.Add(visTree.freeGeoms.PopBack());
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+setupTraverse() {
+    for (int i = 0; i < NumPoses; i++) {
+        setupCamera(cameras[i], poses[i]);
+        visTrees[i].ChunkSize = chunkSize;
+        visTrees[i].Setup(800, glm::radians(45.0f));
+        visTrees[i].TemporalCoherence = false;
+        converge(visTrees[i], cameras[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+discardTraverse() {
+    for (int i = 0; i < NumPoses; i++) {
+        visTrees[i].Discard();
+    }
+}
+
+//------------------------------------------------------------------------------
+static int
+benchTraverse(int poseIndex, uint64_t& check) {
+    VisTree& visTree = visTrees[poseIndex];
+    for (int i = 0; i < NumTraversals; i++) {
+        visTree.Traverse(cameras[poseIndex]);
+        check += visTree.drawNodes.Size() + visTree.NumVisitedNodes + visTree.NumOccludedNodes;
+    }
+    return NumTraversals;
+}
+
+//------------------------------------------------------------------------------
+//  frustum test inputs: a million boxes around the first pose's camera
+//
+static float* boxes = nullptr;      // x0, x1, y0, y1, z0, z1 per box
+static BoxBatch* boxBatches = nullptr;
+
+//------------------------------------------------------------------------------
+static void
+setupBoxes() {
+    seed = 2;
+    boxes = (float*) Memory::Alloc(NumBoxes * 6 * sizeof(float));
+    boxBatches = (BoxBatch*) Memory::Alloc(NumBatches * sizeof(BoxBatch));
+    for (int i = 0; i < NumBoxes; i++) {
+        float* b = boxes + i * 6;
+        const float sizeX = float(Config::ChunkSizeXY << rnd(6));
+        const float sizeZ = float(Config::ChunkSizeXY << rnd(6));
+        b[0] = float(rnd(8192) - 4096);
+        b[1] = b[0] + sizeX;
+        b[2] = 0.0f;
+        b[3] = float(Config::ChunkSizeZ);
+        b[4] = float(rnd(8192) - 4096);
+        b[5] = b[4] + sizeZ;
+    }
+    for (int i = 0; i < NumBatches; i++) {
+        boxBatches[i] = BoxBatch();
+        for (int j = 0; j < BoxBatch::MaxNumBoxes; j++) {
+            const float* b = boxes + (i * BoxBatch::MaxNumBoxes + j) * 6;
+            boxBatches[i].Add(b[0], b[1], b[2], b[3], b[4], b[5]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+discardBoxes() {
+    Memory::Free(boxes);
+    Memory::Free(boxBatches);
+}
+
+//------------------------------------------------------------------------------
+static int
+benchBoxVisible(int, uint64_t& check) {
+    const Camera& camera = cameras[0];
+    int numVisible = 0;
+    for (int i = 0; i < NumBoxes; i++) {
+        const float* b = boxes + i * 6;
+        numVisible += camera.BoxVisible(b[0], b[1], b[2], b[3], b[4], b[5]) ? 1 : 0;
+    }
+    check += numVisible;
+    return NumBoxes;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchBoxVisibleMargin(int, uint64_t& check) {
+    const Camera& camera = cameras[0];
+    int numVisible = 0;
+    float margin = 0.0f;
+    for (int i = 0; i < NumBoxes; i++) {
+        const float* b = boxes + i * 6;
+        numVisible += camera.BoxVisible(b[0], b[1], b[2], b[3], b[4], b[5], margin) ? 1 : 0;
+    }
+    check += numVisible;
+    return NumBoxes;
+}
+
+//------------------------------------------------------------------------------
+static int
+benchBoxesVisible(int, uint64_t& check) {
+    const Camera& camera = cameras[0];
+    float margins[BoxBatch::MaxNumBoxes];
+    int numVisible = 0;
+    for (int i = 0; i < NumBatches; i++) {
+        uint32_t mask = camera.BoxesVisible(boxBatches[i], margins);
+        while (mask) {
+            numVisible++;
+            mask &= mask - 1;
+        }
+    }
+    check += numVisible;
+    return NumBoxes;
+}
+
+//------------------------------------------------------------------------------
+//  MinDist inputs: positions and node bounds at all levels
+//
+struct minDistSample {
+    int64_t x, y;
+    VisBounds bounds;
+};
+static minDistSample* minDistSamples = nullptr;
+
+//------------------------------------------------------------------------------
+static void
+setupMinDist() {
+    seed = 3;
+    minDistSamples = (minDistSample*) Memory::Alloc(NumMinDistSamples * sizeof(minDistSample));
+    for (int i = 0; i < NumMinDistSamples; i++) {
+        minDistSample& s = minDistSamples[i];
+        s.x = rnd(1 << 20) - (1 << 19);
+        s.y = rnd(1 << 20) - (1 << 19);
+        s.bounds = VisTree::Bounds(rnd(numLevels + 1), s.x + rnd(1 << 16) - (1 << 15), s.y + rnd(1 << 16) - (1 << 15), chunkSize);
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+discardMinDist() {
+    Memory::Free(minDistSamples);
+}
+
+//------------------------------------------------------------------------------
+static int
+benchMinDist(int, uint64_t& check) {
+    float sum = 0.0f;
+    for (int i = 0; i < NumMinDistOps; i++) {
+        const minDistSample& s = minDistSamples[i & (NumMinDistSamples - 1)];
+        sum += VisTree::MinDist(s.x, s.y, s.bounds);
+    }
+    check += uint64_t(sum / NumMinDistOps);
+    return NumMinDistOps;
+}
+
+//------------------------------------------------------------------------------
+//  benchmark runner
+//
+static int numRuns = 10;
+static const char* filter = nullptr;
+static FILE* out = nullptr;
+
+//------------------------------------------------------------------------------
+static void
+run(const char* name, int (*func)(int, uint64_t&), int arg) {
+    if (filter && !strstr(name, filter)) {
+        return;
+    }
+    // the warm-up run computes the check value
+    uint64_t check = 0;
+    const int numOps = func(arg, check);
+    double sum = 0.0;
+    double sumSq = 0.0;
+    double minNs = 1.0e30;
+    for (int i = 0; i < numRuns; i++) {
+        uint64_t runCheck = 0;
+        const TimePoint start = Clock::Now();
+        func(arg, runCheck);
+        const double ns = Clock::Since(start).AsNanoSeconds() / numOps;
+        if (runCheck != check) {
+            Log::Warn("%s: check value differs between runs\n", name);
+        }
+        sum += ns;
+        sumSq += ns * ns;
+        minNs = ns < minNs ? ns : minNs;
+    }
+    const double mean = sum / numRuns;
+    const double variance = numRuns > 1 ? (sumSq - sum * mean) / (numRuns - 1) : 0.0;
+    const double stddev = variance > 0.0 ? sqrt(variance) : 0.0;
+    const double opsPerSec = mean > 0.0 ? 1.0e9 / mean : 0.0;
+    Log::Info("%-32s %12.1f ns/op  +-%5.1f%%  min %12.1f  %14.0f ops/s  check %llu\n",
+        name, mean, mean > 0.0 ? 100.0 * stddev / mean : 0.0, minNs, opsPerSec, (unsigned long long) check);
+    if (out) {
+        fprintf(out, "{\"name\":\"%s\",\"ops\":%d,\"runs\":%d,\"ns_per_op\":%.2f,\"stddev_ns\":%.2f,\"min_ns\":%.2f,\"ops_per_sec\":%.1f,\"check\":%llu}\n",
+            name, numOps, numRuns, mean, stddev, minNs, opsPerSec, (unsigned long long) check);
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, const char** argv) {
+    Core::Setup();
+    numRuns = atoi(arg(argc, argv, "-runs", "10"));
+    numRuns = numRuns > 0 ? numRuns : 1;
+    filter = arg(argc, argv, "-filter", nullptr);
+    const char* outPath = arg(argc, argv, "-out", nullptr);
+    chunkSize = atoi(arg(argc, argv, "-chunksize", "32"));
+    if (!VoxelGenerator::IsValidChunkSize(chunkSize)) {
+        Log::Warn("invalid chunk size %d (16, 32 or 64)\n", chunkSize);
+        Core::Discard();
+        return 10;
+    }
+    voxelGenerator.Setup(chunkSize);
+    if (outPath) {
+        out = fopen(outPath, "w");
+        if (!out) {
+            Log::Warn("failed to open '%s'\n", outPath);
+            Core::Discard();
+            return 10;
+        }
+    }
+    geomMesher.Setup(Config::GeomMaxNumQuads);
+    MemTrack::Alloc(MemTrack::Generator, MemTrack::CPU, sizeof(voxelGenerator));
+    // the VisTree setup knows the number of levels for the chunk size
+    setupTraverse();
+    numLevels = visTrees[0].NumLevels();
+    setupChunks();
+    setupBoxes();
+    setupMinDist();
+
+    Log::Info("chunk size %dx%dx%d, %d runs\n", chunkSize, chunkSize, Config::ChunkSizeZ, numRuns);
+    const bool meshersMatch = checkMeshers();
+    char name[64];
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        snprintf(name, sizeof(name), "GenSimplex/lvl%d", lvl);
+        run(name, benchGenSimplex, lvl);
+    }
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        snprintf(name, sizeof(name), "GenSimplexHeightField/lvl%d", lvl);
+        run(name, benchGenSimplexHeightField, lvl);
+    }
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        snprintf(name, sizeof(name), "Meshify/volume/lvl%d", lvl);
+        run(name, benchMeshifyVolume, lvl);
+    }
+    for (int lvl = 0; lvl < numLevels; lvl++) {
+        snprintf(name, sizeof(name), "Meshify/heightfield/lvl%d", lvl);
+        run(name, benchMeshifyHeightField, lvl);
+    }
+    for (int i = 0; i < NumPoses; i++) {
+        snprintf(name, sizeof(name), "Traverse/pose%d", i);
+        run(name, benchTraverse, i);
+    }
+    run("BoxVisible", benchBoxVisible, 0);
+    run("BoxVisible/margin", benchBoxVisibleMargin, 0);
+    run("BoxesVisible/batch8", benchBoxesVisible, 0);
+    run("MinDist", benchMinDist, 0);
+
+    MemTrack::Dump();
+    if (out) {
+        for (int i = 0; i < MemTrack::NumTags; i++) {
+            const MemTrack::Tag tag = MemTrack::Tag(i);
+            fprintf(out, "{\"memory\":\"%s\",\"cpu_bytes\":%lld,\"cpu_peak_bytes\":%lld,\"gpu_bytes\":%lld,\"gpu_peak_bytes\":%lld}\n",
+                MemTrack::Name(tag),
+                (long long) MemTrack::Current(tag, MemTrack::CPU), (long long) MemTrack::Peak(tag, MemTrack::CPU),
+                (long long) MemTrack::Current(tag, MemTrack::GPU), (long long) MemTrack::Peak(tag, MemTrack::GPU));
+        }
+        fclose(out);
+    }
+    discardMinDist();
+    discardBoxes();
+    discardTraverse();
+    discardChunks();
+    geomMesher.Discard();
+    Core::Discard();
+    return meshersMatch ? 0 : 10;
+}
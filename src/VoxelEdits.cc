@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------------
+//  VoxelEdits.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "VoxelEdits.h"
+#include "MemTrack.h"
+#include "glm/common.hpp"
+
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+VisBounds
+VoxelEdits::add(const edit& e) {
+    this->edits.Add(e);
+    MemTrack::Resize(MemTrack::Edits, MemTrack::CPU, this->trackedBytes, this->edits.Capacity() * sizeof(edit));
+    return VisBounds(e.X0, e.X1, e.Y0, e.Y1);
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+VoxelEdits::SetVoxel(int64_t x, int64_t y, int z, uint8_t blockType) {
+    return this->Box(x, y, z, x + 1, y + 1, z + 1, blockType);
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+VoxelEdits::Box(int64_t x0, int64_t y0, int z0, int64_t x1, int64_t y1, int z1, uint8_t blockType) {
+    o_assert_dbg((x0 < x1) && (y0 < y1) && (z0 < z1));
+    edit e;
+    e.Type = edit::BoxType;
+    e.BlockType = blockType;
+    e.X0 = x0; e.X1 = x1;
+    e.Y0 = y0; e.Y1 = y1;
+    e.Z0 = z0; e.Z1 = z1;
+    return this->add(e);
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+VoxelEdits::Sphere(int64_t x, int64_t y, int z, int radius, uint8_t blockType) {
+    o_assert_dbg(radius >= 0);
+    edit e;
+    e.Type = edit::SphereType;
+    e.BlockType = blockType;
+    e.X0 = x - radius; e.X1 = x + radius + 1;
+    e.Y0 = y - radius; e.Y1 = y + radius + 1;
+    e.Z0 = z - radius; e.Z1 = z + radius + 1;
+    // the center of the center voxel
+    e.CX = double(x) + 0.5;
+    e.CY = double(y) + 0.5;
+    e.CZ = double(z) + 0.5;
+    e.Radius2 = double(radius) * double(radius);
+    return this->add(e);
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelEdits::Clear() {
+    this->edits.Clear();
+    MemTrack::Resize(MemTrack::Edits, MemTrack::CPU, this->trackedBytes, 0);
+}
+
+//------------------------------------------------------------------------------
+int
+VoxelEdits::NumEdits() const {
+    return this->edits.Size();
+}
+
+//------------------------------------------------------------------------------
+VisBounds
+VoxelEdits::Apron(const VisBounds& bounds, int chunkSize) {
+    const int64_t voxelSize = (bounds.x1 - bounds.x0) / chunkSize;
+    return VisBounds(bounds.x0 - voxelSize, bounds.x1 + voxelSize, bounds.y0 - voxelSize, bounds.y1 + voxelSize);
+}
+
+//------------------------------------------------------------------------------
+bool
+VoxelEdits::Intersects(const VisBounds& area) const {
+    for (const edit& e : this->edits) {
+        if ((e.X0 < area.x1) && (e.X1 > area.x0) && (e.Y0 < area.y1) && (e.Y1 > area.y0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+bool
+VoxelEdits::inside(const edit& e, double x, double y, double z) {
+    if (edit::SphereType == e.Type) {
+        const double dx = x - e.CX;
+        const double dy = y - e.CY;
+        const double dz = z - e.CZ;
+        return (dx*dx + dy*dy + dz*dz) <= e.Radius2;
+    }
+    // the caller only passes points inside the bounding box
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelEdits::Apply(const VisBounds& bounds, Volume& vol, int firstEdit) const {
+    // volume voxel (i, j, k) covers the world voxels starting at
+    // (x0 + (i-OffsetX)*voxelSize, y0 + (j-OffsetY)*voxelSize, k), each
+    // voxel takes the value of the last edit containing its center, edits
+    // before firstEdit are already contained in the volume (see ChunkStore)
+    const VisBounds apron = Apron(bounds, vol.SizeX);
+    const int64_t voxelSize = (bounds.x1 - bounds.x0) / vol.SizeX;
+    const double invVoxelSize = 1.0 / double(voxelSize);
+    for (int editIndex = firstEdit; editIndex < this->edits.Size(); editIndex++) {
+        const edit& e = this->edits[editIndex];
+        if ((e.X0 >= apron.x1) || (e.X1 <= apron.x0) || (e.Y0 >= apron.y1) || (e.Y1 <= apron.y0)) {
+            continue;
+        }
+        // voxel index ranges whose centers are inside the edit's bounding box
+        const int i0 = glm::max(0, int(glm::ceil(double(e.X0 - bounds.x0) * invVoxelSize - 0.5)) + vol.OffsetX);
+        const int i1 = glm::min(vol.ArraySizeX, int(glm::ceil(double(e.X1 - bounds.x0) * invVoxelSize - 0.5)) + vol.OffsetX);
+        const int j0 = glm::max(0, int(glm::ceil(double(e.Y0 - bounds.y0) * invVoxelSize - 0.5)) + vol.OffsetY);
+        const int j1 = glm::min(vol.ArraySizeY, int(glm::ceil(double(e.Y1 - bounds.y0) * invVoxelSize - 0.5)) + vol.OffsetY);
+        const int k0 = glm::max(0, e.Z0);
+        const int k1 = glm::min(vol.ArraySizeZ, e.Z1);
+        for (int i = i0; i < i1; i++) {
+            const double x = double(bounds.x0) + (i - vol.OffsetX + 0.5) * voxelSize;
+            for (int j = j0; j < j1; j++) {
+                const double y = double(bounds.y0) + (j - vol.OffsetY + 0.5) * voxelSize;
+                uint8_t* column = vol.Blocks + (i * vol.ArraySizeY + j) * vol.ArraySizeZ;
+                for (int k = k0; k < k1; k++) {
+                    if (inside(e, x, y, k + 0.5)) {
+                        column[k] = e.BlockType;
+                    }
+                }
+            }
+        }
+    }
+}
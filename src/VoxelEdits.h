@@ -0,0 +1,60 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class VoxelEdits
+    @brief sparse overlay of runtime voxel edits on top of the generator
+
+    Edits are brush operations (boxes and spheres, a single voxel is a
+    1x1x1 box) kept in the order they were made, later edits overwrite
+    earlier ones. Coordinates are world voxels with x/y horizontal (same
+    as VisBounds) and z up. Edits are applied to generated chunk volumes
+    by sampling each (possibly coarse LOD) voxel at its center, so small
+    edits disappear at coarse LODs like any other small detail.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include "Volume.h"
+#include "VisBounds.h"
+
+class VoxelEdits {
+public:
+    /// set a single voxel (blockType 0 removes the voxel)
+    VisBounds SetVoxel(int64_t x, int64_t y, int z, uint8_t blockType);
+    /// fill a box (min inclusive, max exclusive), return the horizontal area touched
+    VisBounds Box(int64_t x0, int64_t y0, int z0, int64_t x1, int64_t y1, int z1, uint8_t blockType);
+    /// fill a sphere, return the horizontal area touched
+    VisBounds Sphere(int64_t x, int64_t y, int z, int radius, uint8_t blockType);
+    /// remove all edits
+    void Clear();
+    /// number of edits
+    int NumEdits() const;
+
+    /// get the area a chunk's voxels depend on (its bounds plus the 1-voxel apron)
+    static VisBounds Apron(const VisBounds& bounds, int chunkSize);
+    /// return true if any edit touches the area
+    bool Intersects(const VisBounds& area) const;
+    /// apply edits (starting at firstEdit) touching a chunk to the chunk's volume (including apron)
+    void Apply(const VisBounds& bounds, Volume& volume, int firstEdit) const;
+
+    struct edit {
+        enum Type {
+            BoxType,
+            SphereType,
+        } Type = BoxType;
+        uint8_t BlockType = 0;
+        // bounding box, min inclusive, max exclusive
+        int64_t X0 = 0, X1 = 0;
+        int64_t Y0 = 0, Y1 = 0;
+        int Z0 = 0, Z1 = 0;
+        // sphere center (voxel center) and squared radius
+        double CX = 0.0, CY = 0.0, CZ = 0.0;
+        double Radius2 = 0.0;
+    };
+    /// add an edit, return its horizontal area
+    VisBounds add(const edit& e);
+    /// return true if a world-space point is inside an edit
+    static bool inside(const edit& e, double x, double y, double z);
+
+    Oryol::Array<edit> edits;
+    int64_t trackedBytes = 0;
+};
@@ -7,75 +7,258 @@
 #include "glm/gtc/noise.hpp"
 #include "glm/gtc/constants.hpp"
 #include "glm/trigonometric.hpp"
+#include "glm/common.hpp"
 #include "Core/Memory/Memory.h"
 #include "VoxelGenerator.h"
 #include "Volume.h"
 
 using namespace Oryol;
 
+//------------------------------------------------------------------------------
+void
+VoxelGenerator::Setup(int size) {
+    o_assert(IsValidChunkSize(size));
+    this->chunkSize = size;
+}
+
+//------------------------------------------------------------------------------
+bool
+VoxelGenerator::IsValidChunkSize(int size) {
+    return (16 == size) || (32 == size) || (64 == size);
+}
+
+//------------------------------------------------------------------------------
+int
+VoxelGenerator::ChunkSize() const {
+    return this->chunkSize;
+}
+
+//------------------------------------------------------------------------------
+int
+VoxelGenerator::VolumeSizeXY() const {
+    return this->chunkSize + 2;
+}
+
 //------------------------------------------------------------------------------
 Volume
 VoxelGenerator::initVolume() {
     Volume vol;
-    vol.Blocks = (uint8_t*) this->voxels;
-    vol.ArraySizeX = vol.ArraySizeY = VolumeSizeXY;
+    vol.Blocks = this->voxels;
+    vol.ArraySizeX = vol.ArraySizeY = this->VolumeSizeXY();
     vol.ArraySizeZ = VolumeSizeZ;
-    vol.SizeX = vol.SizeY = Config::ChunkSizeXY;
+    vol.SizeX = vol.SizeY = this->chunkSize;
     vol.SizeZ = Config::ChunkSizeZ;
     vol.OffsetX = vol.OffsetY = vol.OffsetZ = 1;
     return vol;
 }
 
 //------------------------------------------------------------------------------
-Volume
-VoxelGenerator::GenSimplex(const VisBounds& bounds) {
+HeightField
+VoxelGenerator::initHeightField() {
+    HeightField hf;
+    hf.Heights = this->heights;
+    hf.ArraySizeX = hf.ArraySizeY = this->VolumeSizeXY();
+    hf.SizeX = hf.SizeY = this->chunkSize;
+    hf.SizeZ = Config::ChunkSizeZ;
+    hf.OffsetX = hf.OffsetY = hf.OffsetZ = 1;
+    return hf;
+}
 
-    const int x0 = bounds.x0;
-    const int x1 = bounds.x1;
-    const int y0 = bounds.y0;
-    const int y1 = bounds.y1;
+//------------------------------------------------------------------------------
+uint8_t
+VoxelGenerator::simplexHeight(const glm::vec2& p) {
+    // each simple call is one octave
+    // the position is multiplied with the frequence
+    // the noise is multiplied with the amplitude
+    float n = glm::simplex(p*0.5f) * 1.5f;
+    n += glm::simplex(p*2.5f)*0.35f;
+    n += glm::simplex(p*10.0f)*0.55f;
+    int8_t ni = glm::clamp(n*0.5f + 0.5f, 0.0f, 1.0f) * (VolumeSizeZ - 1);
+    // the bottom voxel is always solid
+    return ni > 1 ? ni : 1;
+}
 
-    const float voxelSizeX = (x1-x0)/float(Config::ChunkSizeXY);
-    const float voxelSizeY = (y1-y0)/float(Config::ChunkSizeXY);
+//------------------------------------------------------------------------------
+template<int SIZE> void
+VoxelGenerator::genSimplexHeights(const VisBounds& bounds) {
+    const int arraySize = SIZE + 2;
+    const int64_t x0 = bounds.x0;
+    const int64_t y0 = bounds.y0;
+    const int sizeX = int(bounds.x1 - x0);
+    const int sizeY = int(bounds.y1 - y0);
 
-    Volume vol = this->initVolume();
+    const float voxelSizeX = sizeX/float(SIZE);
+    const float voxelSizeY = sizeY/float(SIZE);
+
+    // the chunk's start position in noise space is computed in double
     glm::vec2 p;
-    p.x = (x0-(voxelSizeX*0.5f)) / float(Config::MapDimVoxels);
-    const float dx = ((x1-x0)+2*voxelSizeX) / float(Config::MapDimVoxels*VolumeSizeXY);
-    const float dy = ((y1-y0)+2*voxelSizeY) / float(Config::MapDimVoxels*VolumeSizeXY);
-    for (int x = 0; x < VolumeSizeXY; x++, p.x+=dx) {
-        p.y = (y0-(voxelSizeY*0.5f)) / float(Config::MapDimVoxels);
-        for (int y = 0; y < VolumeSizeXY; y++, p.y+=dy) {
-            // each simple call is one octave
-            // the position is multiplied with the frequence
-            // the noise is multiplied with the amplitude
-            float n = glm::simplex(p*0.5f) * 1.5f;
-            n += glm::simplex(p*2.5f)*0.35f;
-            n += glm::simplex(p*10.0f)*0.55f;
-            int8_t ni = glm::clamp(n*0.5f + 0.5f, 0.0f, 1.0f) * (VolumeSizeZ - 1);
-            this->voxels[x][y][0] = 1;
+    p.x = float((x0-(voxelSizeX*0.5)) / double(Config::MapDimVoxels));
+    const float dx = (sizeX+2*voxelSizeX) / float(Config::MapDimVoxels*arraySize);
+    const float dy = (sizeY+2*voxelSizeY) / float(Config::MapDimVoxels*arraySize);
+    for (int x = 0; x < arraySize; x++, p.x+=dx) {
+        p.y = float((y0-(voxelSizeY*0.5)) / double(Config::MapDimVoxels));
+        for (int y = 0; y < arraySize; y++, p.y+=dy) {
+            this->heights[x*arraySize + y] = simplexHeight(p);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VoxelGenerator::genSimplexHeights(const VisBounds& bounds) {
+    switch (this->chunkSize) {
+        case 16: this->genSimplexHeights<16>(bounds); break;
+        case 32: this->genSimplexHeights<32>(bounds); break;
+        default: this->genSimplexHeights<64>(bounds); break;
+    }
+}
+
+//------------------------------------------------------------------------------
+template<int SIZE> void
+VoxelGenerator::genSimplexVoxels() {
+    const int arraySize = SIZE + 2;
+    for (int x = 0; x < arraySize; x++) {
+        for (int y = 0; y < arraySize; y++) {
+            const int h = this->heights[x*arraySize + y];
+            uint8_t* column = this->voxels + (x*arraySize + y) * VolumeSizeZ;
+            column[0] = 1;
             for (int z = 1; z < VolumeSizeZ; z++) {
-                this->voxels[x][y][z] = z < ni ? z:0;
+                column[z] = z < h ? z:0;
             }
         }
     }
+}
+
+//------------------------------------------------------------------------------
+Volume
+VoxelGenerator::GenSimplex(const VisBounds& bounds) {
+    Volume vol = this->initVolume();
+    this->genSimplexHeights(bounds);
+    switch (this->chunkSize) {
+        case 16: this->genSimplexVoxels<16>(); break;
+        case 32: this->genSimplexVoxels<32>(); break;
+        default: this->genSimplexVoxels<64>(); break;
+    }
     return vol;
 }
 
+//------------------------------------------------------------------------------
+HeightField
+VoxelGenerator::GenSimplexHeightField(const VisBounds& bounds) {
+    HeightField hf = this->initHeightField();
+    this->genSimplexHeights(bounds);
+    hf.GeomError = this->geomError(bounds);
+    return hf;
+}
+
+//------------------------------------------------------------------------------
+template<int SIZE> float
+VoxelGenerator::geomError(const VisBounds& bounds) const {
+    // estimate of the maximum height difference between this chunk's
+    // columns and the columns of the next finer level (each column
+    // covers 2x2 finer columns), a height step of 1 is the smallest error:
+    //
+    // - the finer columns are a quarter column away from the column's
+    //   center, so on smooth slopes the error is at most half the
+    //   biggest step to a neighbour column
+    // - detail between the columns is found by sampling the noise at
+    //   every 8th finer column (staggered per row), the max of the
+    //   samples is scaled up a bit since it misses some peaks
+    //
+    // this is within about 10% of sampling all finer columns at a
+    // fraction of the cost (which was 4x the cost of the heights), but
+    // once the columns are 16 or more voxels apart the noise has detail
+    // between the samples and the estimate can fall short, so the coarse
+    // levels (few nodes, most visible popping) sample all finer columns
+    // and the error is exact
+    const int arraySize = SIZE + 2;
+    const int voxelSize = int(bounds.x1 - bounds.x0) / SIZE;
+    if (voxelSize <= 1) {
+        // there is no finer level
+        return 1.0f;
+    }
+    int maxStep = 0;
+    for (int x = 1; x <= SIZE; x++) {
+        for (int y = 1; y <= SIZE; y++) {
+            const int h = this->heights[x * arraySize + y];
+            for (int dx = -1; dx <= 1; dx++) {
+                const uint8_t* column = this->heights + (x + dx) * arraySize + y;
+                for (int dy = -1; dy <= 1; dy++) {
+                    const int step = glm::abs(int(column[dy]) - h);
+                    maxStep = step > maxStep ? step : maxStep;
+                }
+            }
+        }
+    }
+    const int sampleStride = voxelSize >= 16 ? 1 : 8;
+    const float fineSize = voxelSize * 0.5f;
+    int maxDiff = 0;
+    for (int x = 0; x < 2*SIZE; x++) {
+        glm::vec2 p;
+        p.x = float((bounds.x0 + (x + 0.5) * fineSize) / double(Config::MapDimVoxels));
+        const uint8_t* column = this->heights + ((x>>1) + 1) * arraySize + 1;
+        for (int y = (x * 3) % sampleStride; y < 2*SIZE; y += sampleStride) {
+            p.y = float((bounds.y0 + (y + 0.5) * fineSize) / double(Config::MapDimVoxels));
+            const int diff = glm::abs(int(simplexHeight(p)) - int(column[y>>1]));
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+    }
+    const float slopeError = glm::ceil(maxStep * 0.5f);
+    const float sampleError = glm::ceil(1 == sampleStride ? float(maxDiff) : maxDiff * 1.25f);
+    return glm::max(1.0f, glm::max(slopeError, sampleError));
+}
+
+//------------------------------------------------------------------------------
+float
+VoxelGenerator::geomError(const VisBounds& bounds) const {
+    switch (this->chunkSize) {
+        case 16: return this->geomError<16>(bounds);
+        case 32: return this->geomError<32>(bounds);
+        default: return this->geomError<64>(bounds);
+    }
+}
+
 //------------------------------------------------------------------------------
 Volume
 VoxelGenerator::GenDebug(const VisBounds& bounds, int lvl) {
     int8_t blockType = lvl+1;
     Volume vol = this->initVolume();
-    Memory::Clear(this->voxels, sizeof(this->voxels));
-    for (int x = 0; x < VolumeSizeXY; x++) {
-        for (int y = 0; y < VolumeSizeXY; y++) {
+    const int arraySize = this->VolumeSizeXY();
+    Memory::Clear(this->voxels, arraySize * arraySize * VolumeSizeZ);
+    for (int x = 0; x < arraySize; x++) {
+        for (int y = 0; y < arraySize; y++) {
             int8_t bt = blockType;
-            if ((x<=1)||(y<=1)||(x>=VolumeSizeXY-2)||(y>=VolumeSizeXY-2)) {
+            if ((x<=1)||(y<=1)||(x>=arraySize-2)||(y>=arraySize-2)) {
                 bt = blockType + 1;
             }
-            this->voxels[x][y][lvl+1] = bt;
+            this->voxels[(x*arraySize + y) * VolumeSizeZ + lvl+1] = bt;
+        }
+    }
+    return vol;
+}
+
+//------------------------------------------------------------------------------
+template<int SIZE> void
+VoxelGenerator::genCheckerboard() {
+    const int arraySize = SIZE + 2;
+    for (int x = 0; x < arraySize; x++) {
+        for (int y = 0; y < arraySize; y++) {
+            uint8_t* column = this->voxels + (x*arraySize + y) * VolumeSizeZ;
+            for (int z = 0; z < VolumeSizeZ; z++) {
+                column[z] = ((x^y^z) & 1) ? (z|1) : 0;
+            }
         }
     }
+}
+
+//------------------------------------------------------------------------------
+Volume
+VoxelGenerator::GenCheckerboard() {
+    Volume vol = this->initVolume();
+    switch (this->chunkSize) {
+        case 16: this->genCheckerboard<16>(); break;
+        case 32: this->genCheckerboard<32>(); break;
+        default: this->genCheckerboard<64>(); break;
+    }
     return vol;
 }
@@ -3,23 +3,62 @@
 /**
     @VoxelGenerator
     @brief generate voxel chunk data and meshify them
+
+    The chunk size along x and y is selected with Setup() (16, 32 or 64,
+    Config::ChunkSizeXY by default). The buffers are sized for the
+    biggest chunks but always densely packed for the selected size, and
+    the generation loops are instantiated for each size, so sizes and
+    array strides are compile-time constants in the hot loops.
 */
 #include "Volume.h"
+#include "HeightField.h"
 #include "Config.h"
 #include "VisBounds.h"
+#include "glm/vec2.hpp"
 
 class VoxelGenerator {
 public:
-    static const int VolumeSizeXY = Config::ChunkSizeXY + 2;
     static const int VolumeSizeZ = Config::ChunkSizeZ + 2;
+    static const int MaxVolumeSizeXY = Config::MaxChunkSizeXY + 2;
+
+    /// select the chunk size along x and y (16, 32 or 64)
+    void Setup(int chunkSize);
+    /// return true if chunks of this size can be generated
+    static bool IsValidChunkSize(int chunkSize);
+    /// the chunk size along x and y
+    int ChunkSize() const;
+    /// the volume array size along x and y (chunk size plus 1-voxel apron)
+    int VolumeSizeXY() const;
 
     /// generate simplex noise voxel data
     Volume GenSimplex(const VisBounds& bounds);
+    /// generate simplex noise column heights only (same terrain as GenSimplex)
+    HeightField GenSimplexHeightField(const VisBounds& bounds);
     /// generate debug voxel data
     Volume GenDebug(const VisBounds& bounds, int lvl);
+    /// generate a 3D checkerboard (worst case for the mesher)
+    Volume GenCheckerboard();
 
     /// initialize a volume object
     Volume initVolume();
+    /// initialize a height field object
+    HeightField initHeightField();
+    /// compute simplex noise column heights into the heights array
+    void genSimplexHeights(const VisBounds& bounds);
+    /// geometric error of the current heights array against the next finer level (estimated below level 4)
+    float geomError(const VisBounds& bounds) const;
+    /// compute the simplex noise terrain height at a normalized map position
+    static uint8_t simplexHeight(const glm::vec2& p);
+
+    // x-major, VolumeSizeXY() x VolumeSizeXY() (x VolumeSizeZ) are used
+    uint8_t voxels[MaxVolumeSizeXY * MaxVolumeSizeXY * VolumeSizeZ];
+    uint8_t heights[MaxVolumeSizeXY * MaxVolumeSizeXY];
+
+private:
+    template<int SIZE> void genSimplexHeights(const VisBounds& bounds);
+    template<int SIZE> void genSimplexVoxels();
+    template<int SIZE> float geomError(const VisBounds& bounds) const;
+    template<int SIZE> void genCheckerboard();
 
-    uint8_t voxels[VolumeSizeXY][VolumeSizeXY][VolumeSizeZ];
-};
\ No newline at end of file
+    int chunkSize = Config::ChunkSizeXY;
+};
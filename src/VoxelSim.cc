@@ -0,0 +1,1184 @@
+//------------------------------------------------------------------------------
+//  VoxelSim.cc
+//
+//  Headless runs of the voxel core without rendering: a scripted camera
+//  drives the VisTree, geom jobs are generated and meshed like in
+//  VoxelTest, the resulting geoms are only counted.
+//
+//  - flight: long level flight, reports node and memory usage and timings
+//  - stress: random flight with teleports and failing geom jobs, checks
+//    the VisTree invariants every frame (-budget limits the nodes)
+//  - edit: low flight with a brush edit every 30 frames, reports how many
+//    frames and milliseconds until the edits were visible
+//  - long: straight level flight at 8 units per frame across many root
+//    cells, fails if no roots are recycled, or if in the second half of the
+//    frames after the warm-up the used nodes exceed those of the first
+//    half by more than 10% or the node memory or tracked CPU memory
+//    (without the capped chunk store) exceed the first half at all
+//  - pan: hovers still during the warm-up until the VisTree has settled,
+//    then stays idle for the first half of the remaining frames and pans
+//    slowly for the second half, reports the traverse time and visited and
+//    reused nodes of both phases
+//
+//  -record writes the scenario's camera path and edits, -replay drives the
+//  camera from a recorded path (also from VoxelTest) instead of the
+//  scenario. The job sequence and final draw list hashes are printed,
+//  identical replays must have identical hashes. The report ends with
+//  the per-subsystem memory (current and peak).
+//
+//  -checkerboard replaces the terrain with the worst-case 3D checkerboard
+//  (see VoxelGenerator::GenCheckerboard), every chunk goes through
+//  stb_voxel_render and is chained over many geoms, the report has the
+//  geoms per chunk and the jobs which failed because the pool ran dry.
+//
+//  -index32 models GeomPool's 32-bit index mode: the meshers emit up to
+//  Config::GeomLargeMaxNumQuads per geom and GeomPool's 32 large
+//  geoms are added, dense chunks are split over regular geoms when all
+//  large geoms are in use (like VoxelTest). -compareindex runs the scenario
+//  in 16- and 32-bit mode and prints the draw calls, Gfx calls (draw state,
+//  uniform block and draw per geom), quads per draw, geoms per chunk, failed jobs, geom GPU
+//  memory and the CPU time of the draw list walk per frame side by side,
+//  use it with -checkerboard for the dense worst case.
+//
+//  -nocoherence disables the VisTree's temporal coherence (like VoxelTest),
+//  -comparecoherence runs the scenario with coherence on and off and prints
+//  the traverse time and visited nodes per phase side by side, use it with
+//  -scenario pan for the idle and slow pan frames.
+//
+//  Heap allocations are counted per frame after -warmup frames, the steady
+//  state frames of the flight scenario (or any scenario with -noalloc)
+//  must not allocate, otherwise the run fails.
+//
+//  With -threads n the jobs of a frame are generated and meshified by
+//  ChunkWorkers with n threads instead of one after the other. -verify runs
+//  the scenario (or replay) with ChunkWorkers on 1, 2 and n threads (at
+//  least 4) and compares the job sequences, the voxel and mesh hashes of
+//  every generated chunk (by level/x/y) and the final draw lists.
+//
+//  The tuning knobs (see Settings.h) are loaded with -config file and
+//  overridden with -<knob> value (-budget is the same as -nodes). -sweep
+//  runs the scenario for every combination of the given knob values, e.g.
+//  -sweep "tau=10,15,20 geoms=500,700,1000", and prints a table of the
+//  average drawn quads, peak memory (CPU and estimated GPU), average job
+//  latency (frames from queueing to applying a job) and CPU time per frame
+//  (traversal and jobs). Runs on the Pareto front (no other run has more
+//  quads with at most the memory, latency and CPU time) are marked. The
+//  table also has the drawn geoms (draw calls) per frame, the time per job
+//  and in the edit scenario the edit latency, so -sweep chunksize=16,32,64
+//  compares the chunk sizes head-to-head on the same terrain and path.
+//
+//  voxelsim [-scenario flight|stress|edit|long|pan] [-frames n] [-seed n]
+//           [-config file] [-tau n] [-geoms n] [-nodes n] [-jobs perFrame]
+//           [-displaywidth n] [-chunksize 16|32|64] [-failrate percent] [-trace file.json]
+//           [-record path.vxcp] [-replay path.vxcp] [-warmup frames] [-noalloc]
+//           [-threads n] [-verify] [-sweep "knob=v0,v1,... knob=..."] [-checkerboard]
+//           [-index32] [-compareindex] [-nocoherence] [-comparecoherence]
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Core/Core.h"
+#include "Core/Log.h"
+#include "Core/Containers/Array.h"
+#include "Core/Containers/Map.h"
+#include "Core/Memory/Memory.h"
+#include "Core/Time/Clock.h"
+#include "ChunkSource.h"
+#include "ChunkWorkers.h"
+#include "CameraPath.h"
+#include "Settings.h"
+#include "MemTrack.h"
+#include "AllocCount.h"
+#include "Trace.h"
+#include "glm/trigonometric.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+
+using namespace Oryol;
+
+// the camera origin is moved when the camera gets this far away from it
+const float MaxOriginDist = 1024.0f;
+const int ChunkStoreMemory = 16 * 1024 * 1024;
+// vertex size of GeomPool meshes (position and normal, UByte4N each)
+const int GeomVertexSize = 8;
+// large geoms GeomPool adds in 32-bit index mode (GeomPool::NumLargeGeoms)
+const int NumLargeGeoms = 32;
+
+//------------------------------------------------------------------------------
+/// geom index allocator standing in for GeomPool (same alloc rules)
+struct simGeomPool {
+    void Setup(int numGeoms, bool index32) {
+        const int numLargeGeoms = index32 ? NumLargeGeoms : 0;
+        this->numGeoms = numGeoms;
+        this->next.Reserve(numGeoms + numLargeGeoms);
+        this->quads.Reserve(numGeoms + numLargeGeoms);
+        this->free.Reserve(numGeoms);
+        this->freeLarge.Reserve(numLargeGeoms);
+        for (int i = 0; i < numGeoms + numLargeGeoms; i++) {
+            this->next.Add(InvalidIndex);
+            this->quads.Add(0);
+        }
+        for (int i = 0; i < numGeoms; i++) {
+            this->free.Add(numGeoms - 1 - i);
+        }
+        for (int i = 0; i < numLargeGeoms; i++) {
+            this->freeLarge.Add(numGeoms + numLargeGeoms - 1 - i);
+        }
+        // the GPU memory GeomPool would allocate for its meshes and the shared index buffer
+        const int maxNumQuads = index32 ? Config::GeomLargeMaxNumQuads : Config::GeomMaxNumQuads;
+        this->gpuBytes = int64_t(numGeoms) * Config::GeomMaxNumVertices * GeomVertexSize +
+            int64_t(numLargeGeoms) * Config::GeomLargeMaxNumVertices * GeomVertexSize +
+            int64_t(maxNumQuads) * 6 * (index32 ? 4 : 2);
+        MemTrack::Alloc(MemTrack::Geoms, MemTrack::GPU, this->gpuBytes);
+    }
+    void Discard() {
+        MemTrack::Free(MemTrack::Geoms, MemTrack::GPU, this->gpuBytes);
+        this->gpuBytes = 0;
+    }
+    bool CanAlloc(int numQuads) const {
+        if (numQuads <= Config::GeomMaxNumQuads) {
+            return !this->free.Empty() || !this->freeLarge.Empty();
+        }
+        else if (!this->freeLarge.Empty()) {
+            return true;
+        }
+        else {
+            return ((numQuads + Config::GeomMaxNumQuads - 1) / Config::GeomMaxNumQuads) <= this->free.Size();
+        }
+    }
+    int MaxAllocQuads() const {
+        return this->freeLarge.Empty() ? Config::GeomMaxNumQuads : Config::GeomLargeMaxNumQuads;
+    }
+    int NumFree() const {
+        return this->free.Size() + this->freeLarge.Size();
+    }
+    int Alloc(int numQuads) {
+        o_assert_dbg(numQuads <= this->MaxAllocQuads());
+        int index;
+        if ((numQuads <= Config::GeomMaxNumQuads) && !this->free.Empty()) {
+            index = this->free.PopBack();
+        }
+        else {
+            index = this->freeLarge.PopBack();
+        }
+        this->next[index] = InvalidIndex;
+        this->quads[index] = numQuads;
+        return index;
+    }
+    void Free(int index) {
+        while (InvalidIndex != index) {
+            if (index < this->numGeoms) {
+                this->free.Add(index);
+            }
+            else {
+                this->freeLarge.Add(index);
+            }
+            index = this->next[index];
+        }
+    }
+    int numGeoms = 0;
+    Array<int> next;
+    Array<int> quads;
+    Array<int> free;
+    Array<int> freeLarge;
+    int64_t gpuBytes = 0;
+};
+
+//------------------------------------------------------------------------------
+/// command line options
+struct options {
+    const char* scenario = "flight";
+    bool stress = false;
+    bool flight = false;
+    bool edit = false;
+    bool longFlight = false;
+    bool pan = false;
+    int numFrames = 0;
+    int failRate = 0;
+    int warmupFrames = 0;
+    uint32_t seed = 1;
+    Settings settings;
+    bool noAlloc = false;
+    bool checkerboard = false;
+    bool index32 = false;
+    bool noCoherence = false;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+};
+
+//------------------------------------------------------------------------------
+/// a generated chunk's identity and output hashes
+struct chunkKey {
+    int level = 0;
+    int64_t x = 0;
+    int64_t y = 0;
+    bool operator==(const chunkKey& rhs) const {
+        return (this->level == rhs.level) && (this->x == rhs.x) && (this->y == rhs.y);
+    };
+    bool operator<(const chunkKey& rhs) const {
+        if (this->level != rhs.level) return this->level < rhs.level;
+        if (this->x != rhs.x) return this->x < rhs.x;
+        return this->y < rhs.y;
+    };
+};
+struct chunkHash {
+    uint64_t voxels = 0;
+    uint64_t mesh = 0;
+};
+
+//------------------------------------------------------------------------------
+/// one run of a scenario, all state is owned by the run
+class simulation {
+public:
+    /// run the scenario, numThreads 0 generates without ChunkWorkers, return false on failure
+    bool Run(const options& opts, int numThreads, bool hashing);
+
+    uint32_t JobHash = 2166136261u;
+    uint32_t DrawHash = 0;
+    int NumDrawNodes = 0;
+    Map<chunkKey, chunkHash> Chunks;
+
+    /// sweep measurements
+    double AvgDrawQuads = 0.0;      // drawn quads per frame
+    double AvgDraws = 0.0;          // drawn geoms (draw calls) per frame
+    double AvgJobTime = 0.0;        // generation and meshing, ms per job
+    double AvgEditLatency = 0.0;    // ms until an edit is visible
+    int64_t PeakMemory = 0;         // CPU and estimated GPU bytes
+    double AvgJobLatency = 0.0;     // frames from queueing to applying a job
+    int MaxJobLatency = 0;
+    double AvgCPUTime = 0.0;        // traversal and jobs, ms per frame
+    /// index mode comparison
+    double AvgGeomsPerChunk = 0.0;
+    int MaxGeomsPerChunk = 0;
+    int NumFailedJobs = 0;
+    int64_t GeomGPUMemory = 0;
+    double AvgDrawListTime = 0.0;   // walk of the draw list and geom chains, ms per frame
+    /// traversals after the warm-up, per camera phase (pan scenario: idle and slow pan)
+    struct phase {
+        int numFrames = 0;
+        Duration traverseTime;
+        int64_t numVisited = 0;
+        int64_t numReused = 0;
+    };
+    phase Phases[2];
+
+private:
+    int rnd(int num);
+    uint32_t drawHash();
+    void freeGeoms();
+    void keepAltitude(float minY, float maxY);
+    void hashJob(const VisTree::GeomGenJob& job);
+    void applyGeoms(const VisTree::GeomGenJob& job, int firstGeom);
+    void countChain(int firstGeom);
+    void countDraws(int& outNumGeoms, int& outNumQuads);
+    void addGeoms(int numQuads, int& firstGeom, int& lastGeom);
+    void processJobs(int maxJobs, int failRate);
+    void processBatch(int maxJobs, int failRate);
+
+    VisTree visTree;
+    ChunkSource chunkSource;
+    GeomMesher geomMesher;
+    ChunkWorkers workers;
+    bool useWorkers = false;
+    simGeomPool geomPool;
+    Camera camera;
+    CameraPath cameraPath;
+    uint32_t seed = 1;
+    int numJobs = 0;
+    int numFailedJobs = 0;
+    int numQuads = 0;
+    int numChainGeoms = 0;      // geoms of all successful non-empty jobs
+    int numChains = 0;
+    int maxChainGeoms = 0;
+    int64_t jobLatency = 0;
+};
+
+//------------------------------------------------------------------------------
+static const char*
+arg(int argc, const char** argv, const char* name, const char* def) {
+    for (int i = 1; i < (argc - 1); i++) {
+        if (0 == strcmp(argv[i], name)) {
+            return argv[i + 1];
+        }
+    }
+    return def;
+}
+
+//------------------------------------------------------------------------------
+static bool
+flag(int argc, const char** argv, const char* name) {
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int
+simulation::rnd(int num) {
+    // fixed LCG so that runs are reproducible across platforms
+    this->seed = this->seed * 1664525 + 1013904223;
+    return int((this->seed >> 8) % uint32_t(num));
+}
+
+//------------------------------------------------------------------------------
+static uint32_t
+hash(uint32_t h, int64_t val) {
+    // FNV-1a over the value's bytes
+    for (int i = 0; i < 8; i++) {
+        h = (h ^ uint32_t((val >> (i * 8)) & 0xFF)) * 16777619u;
+    }
+    return h;
+}
+
+//------------------------------------------------------------------------------
+uint32_t
+simulation::drawHash() {
+    uint32_t h = 2166136261u;
+    for (int32_t nodeIndex : this->visTree.drawNodes) {
+        h = hash(h, nodeIndex);
+        h = hash(h, this->visTree.NodeAt(nodeIndex).geom);
+    }
+    return h;
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::freeGeoms() {
+    while (!this->visTree.freeGeoms.Empty()) {
+        this->geomPool.Free(this->visTree.freeGeoms.PopBack());
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::hashJob(const VisTree::GeomGenJob& job) {
+    this->numJobs++;
+    this->JobHash = hash(this->JobHash, job.Level);
+    this->JobHash = hash(this->JobHash, job.Bounds.x0);
+    this->JobHash = hash(this->JobHash, job.Bounds.y0);
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::applyGeoms(const VisTree::GeomGenJob& job, int firstGeom) {
+    const int latency = this->visTree.FrameIndex() - job.Frame;
+    this->jobLatency += latency;
+    if (latency > this->MaxJobLatency) {
+        this->MaxJobLatency = latency;
+    }
+    this->visTree.ApplyGeoms(job.Node, firstGeom);
+    this->freeGeoms();
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::countChain(int firstGeom) {
+    if (firstGeom < 0) {
+        return;
+    }
+    int num = 0;
+    for (int geom = firstGeom; geom >= 0; geom = this->geomPool.next[geom]) {
+        num++;
+    }
+    this->numChainGeoms += num;
+    this->numChains++;
+    if (num > this->maxChainGeoms) {
+        this->maxChainGeoms = num;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::countDraws(int& outNumGeoms, int& outNumQuads) {
+    outNumGeoms = 0;
+    outNumQuads = 0;
+    for (int32_t nodeIndex : this->visTree.drawNodes) {
+        for (int geom = this->visTree.NodeAt(nodeIndex).geom; geom >= 0; geom = this->geomPool.next[geom]) {
+            outNumGeoms++;
+            outNumQuads += this->geomPool.quads[geom];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::addGeoms(int numQuads, int& firstGeom, int& lastGeom) {
+    // like VoxelTest, without a free large geom a dense mesher result is
+    // split over regular geoms
+    for (int quad = 0; quad < numQuads; ) {
+        const int maxQuads = this->geomPool.MaxAllocQuads();
+        const int num = (numQuads - quad) < maxQuads ? (numQuads - quad) : maxQuads;
+        const int geom = this->geomPool.Alloc(num);
+        quad += num;
+        if (InvalidIndex == lastGeom) {
+            firstGeom = geom;
+        }
+        else {
+            this->geomPool.next[lastGeom] = geom;
+        }
+        lastGeom = geom;
+    }
+    this->numQuads += numQuads;
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::processJobs(int maxJobs, int failRate) {
+    for (int i = 0; (i < maxJobs) && !this->visTree.geomGenJobs.Empty(); i++) {
+        TRACE_SCOPE("geom job");
+        VisTree::GeomGenJob job = this->visTree.geomGenJobs.PopBack();
+        this->hashJob(job);
+        this->chunkSource.Start(job, this->visTree, this->geomMesher);
+        int firstGeom = VisNode::EmptyGeom;
+        int lastGeom = InvalidIndex;
+        GeomMesher::Result meshResult;
+        do {
+            meshResult = this->geomMesher.Meshify();
+            if (meshResult.NumQuads > 0) {
+                if (!this->geomPool.CanAlloc(meshResult.NumQuads) || (this->rnd(100) < failRate)) {
+                    if (firstGeom >= 0) {
+                        this->geomPool.Free(firstGeom);
+                    }
+                    firstGeom = VisNode::InvalidGeom;
+                    this->numFailedJobs++;
+                    break;
+                }
+                this->addGeoms(meshResult.NumQuads, firstGeom, lastGeom);
+            }
+        }
+        while (!meshResult.VolumeDone);
+        this->countChain(firstGeom);
+        this->applyGeoms(job, firstGeom);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::processBatch(int maxJobs, int failRate) {
+    // same as processJobs, but the jobs are generated and meshified by the workers
+    TRACE_SCOPE("geom batch");
+    int num = 0;
+    while ((num < maxJobs) && !this->visTree.geomGenJobs.Empty()) {
+        ChunkWorkers::Task& task = *this->workers.Tasks[num++];
+        task.Job = this->visTree.geomGenJobs.PopBack();
+        this->hashJob(task.Job);
+    }
+    if (0 == num) {
+        return;
+    }
+    this->workers.Run(num, this->chunkSource, this->visTree);
+    for (int i = 0; i < num; i++) {
+        const ChunkWorkers::Task& task = *this->workers.Tasks[i];
+        if (this->workers.Hashing) {
+            chunkKey key;
+            key.level = task.Job.Level;
+            key.x = task.Job.Bounds.x0;
+            key.y = task.Job.Bounds.y0;
+            chunkHash val;
+            val.voxels = task.VoxelHash;
+            val.mesh = task.MeshHash;
+            // chunks are regenerated after edits and recycling, keep the latest
+            if (this->Chunks.Contains(key)) {
+                this->Chunks[key] = val;
+            }
+            else {
+                this->Chunks.Add(key, val);
+            }
+        }
+        int firstGeom = VisNode::EmptyGeom;
+        int lastGeom = InvalidIndex;
+        for (const ChunkWorkers::Geom& geomInfo : task.Geoms) {
+            if (!this->geomPool.CanAlloc(geomInfo.NumQuads) || (this->rnd(100) < failRate)) {
+                if (firstGeom >= 0) {
+                    this->geomPool.Free(firstGeom);
+                }
+                firstGeom = VisNode::InvalidGeom;
+                this->numFailedJobs++;
+                break;
+            }
+            this->addGeoms(geomInfo.NumQuads, firstGeom, lastGeom);
+        }
+        this->countChain(firstGeom);
+        this->applyGeoms(task.Job, firstGeom);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+simulation::keepAltitude(float minY, float maxY) {
+    glm::vec3 pos = this->camera.Pos;
+    pos.y = glm::clamp(pos.y, minY, maxY);
+    this->camera.Pos = pos;
+    this->camera.MoveRotate(glm::vec3(), glm::vec2());
+}
+
+//------------------------------------------------------------------------------
+bool
+simulation::Run(const options& opts, int numThreads, bool hashing) {
+    const Settings& settings = opts.settings;
+    this->seed = opts.seed;
+    MemTrack::ResetPeaks();
+    this->geomPool.Setup(settings.NumGeoms, opts.index32);
+    const int maxNumQuads = opts.index32 ? Config::GeomLargeMaxNumQuads : Config::GeomMaxNumQuads;
+    this->geomMesher.Setup(maxNumQuads);
+    this->chunkSource.Setup(ChunkStoreMemory, settings.ChunkSize);
+    this->chunkSource.Checkerboard = opts.checkerboard;
+    this->useWorkers = numThreads > 0;
+    if (this->useWorkers) {
+        // the stress scenario does up to 3 jobs per frame
+        this->workers.Setup(numThreads, settings.JobsPerFrame > 3 ? settings.JobsPerFrame : 3, maxNumQuads, settings.ChunkSize);
+        this->workers.Hashing = hashing;
+    }
+    this->visTree.MaxNumNodes = settings.MaxNumNodes;
+    this->visTree.LodTau = settings.LodTau;
+    this->visTree.TemporalCoherence = !opts.noCoherence;
+    this->visTree.ChunkSize = settings.ChunkSize;
+    this->visTree.Setup(settings.DisplayWidth, glm::radians(45.0f));
+    this->camera.Setup(glm::dvec3(4096, 48, 4096), glm::radians(45.0f), 800, 600, 0.1f, 10000.0f);
+    int numFrames = opts.numFrames;
+    if (opts.replayPath) {
+        if (!this->cameraPath.Load(opts.replayPath)) {
+            return false;
+        }
+        numFrames = this->cameraPath.NumFrames();
+    }
+    else if (opts.recordPath) {
+        this->cameraPath.StartRecording(numFrames);
+    }
+    // the edit scenario flies low enough for the brush to hit the terrain
+    const float altitude = opts.edit ? 24.0f : 48.0f;
+    // hashing adds chunks to a map, which allocates
+    const bool noAlloc = opts.noAlloc && !hashing;
+
+    const int reportFrames = numFrames >= 10 ? numFrames / 10 : 1;
+    Duration traverseTime, jobTime;
+    Duration maxTraverseTime;
+    int numInvalid = 0;
+    int numEditsVisible = 0;
+    int editFrame = -1;
+    TimePoint editStart;
+    int editLatencyFrames = 0;
+    Duration editLatency;
+    glm::vec3 move(0.0f, 0.0f, -0.75f);
+    glm::vec2 rot;
+    int panPhase = 0;
+    int64_t numAllocs = 0;
+    int numAllocFrames = 0;
+    int64_t drawQuads = 0;
+    int64_t drawGeoms = 0;
+    struct growth {
+        int nodes = 0;
+        int nodeMemory = 0;
+        int64_t cpuMemory = 0;
+        void Update(int n, int nm, int64_t cm) {
+            this->nodes = n > this->nodes ? n : this->nodes;
+            this->nodeMemory = nm > this->nodeMemory ? nm : this->nodeMemory;
+            this->cpuMemory = cm > this->cpuMemory ? cm : this->cpuMemory;
+        }
+        bool Exceeds(const growth& g) const {
+            // the used nodes get 10% slack for the terrain under the camera,
+            // the memory must not grow at all
+            return (10 * this->nodes > 11 * g.nodes) || (this->nodeMemory > g.nodeMemory) ||
+                   (this->cpuMemory > g.cpuMemory);
+        }
+    };
+    growth growthHalves[2];
+    Duration cpuTime;
+    Duration totalJobTime;
+    Duration drawListTime;
+    for (int frame = 0; frame < numFrames; frame++) {
+        TRACE_SCOPE("frame");
+        // all threads, the workers only run while the frame waits for them
+        int64_t frameAllocs = AllocCount::Total();
+        uint8_t actions = 0;
+        // the second half of the frames after the warm-up
+        const bool secondHalf = (frame >= opts.warmupFrames) &&
+            ((2 * (frame - opts.warmupFrames)) >= (numFrames - opts.warmupFrames));
+        panPhase = (opts.pan && secondHalf) ? 1 : 0;
+        if (opts.replayPath) {
+            this->cameraPath.Next(this->camera, actions);
+        }
+        else if (opts.stress) {
+            if (0 == (frame % 60)) {
+                move = glm::vec3((rnd(3) - 1) * 0.5f * rnd(4), (rnd(3) - 1) * 0.3f, (rnd(3) - 1) * rnd(6) * 0.5f);
+                rot = glm::vec2((rnd(3) - 1) * 0.01f, 0.0f);
+            }
+            if (0 == rnd(500)) {
+                // teleport, this recycles the whole root grid
+                this->camera.Pos += glm::vec3(float(rnd(40001) - 20000), 0.0f, float(rnd(40001) - 20000));
+            }
+            this->camera.MoveRotate(move, rot);
+            this->keepAltitude(20.0f, 300.0f);
+        }
+        else if (opts.longFlight) {
+            // straight level flight, leaves the start root after a few hundred frames
+            this->camera.MoveRotate(glm::vec3(0.0f, 0.0f, -8.0f), glm::vec2());
+            this->keepAltitude(altitude, altitude);
+        }
+        else if (opts.pan) {
+            // hover during the warm-up and the idle half, then a slow pan
+            if (panPhase > 0) {
+                this->camera.MoveRotate(glm::vec3(0.0f, 0.0f, -0.05f), glm::vec2(0.001f, 0.0f));
+            }
+        }
+        else {
+            // level flight in a slow circle
+            this->camera.MoveRotate(move, glm::vec2(0.0005f, 0.0f));
+            this->keepAltitude(altitude, altitude);
+        }
+        if (!opts.replayPath) {
+            this->camera.Rebase(MaxOriginDist);
+            if (opts.edit && (0 == (frame % 30))) {
+                // dig into the terrain ahead of the camera
+                actions |= CameraPath::Dig;
+            }
+            if (opts.recordPath) {
+                this->cameraPath.Record(this->camera, actions);
+            }
+        }
+
+        if (actions & (CameraPath::Dig | CameraPath::Place)) {
+            if (actions & CameraPath::Dig) {
+                this->visTree.MarkDirty(this->chunkSource.Brush(this->camera, 0));
+            }
+            if (actions & CameraPath::Place) {
+                this->visTree.MarkDirty(this->chunkSource.Brush(this->camera, Config::ChunkSizeZ));
+            }
+            if (editFrame < 0) {
+                editFrame = frame;
+                editStart = Clock::Now();
+            }
+        }
+
+        TimePoint start = Clock::Now();
+        this->visTree.Traverse(this->camera);
+        const Duration dt = Clock::Since(start);
+        traverseTime += dt;
+        cpuTime += dt;
+        if (dt > maxTraverseTime) {
+            maxTraverseTime = dt;
+        }
+        if (frame >= opts.warmupFrames) {
+            phase& p = this->Phases[panPhase];
+            p.numFrames++;
+            p.traverseTime += dt;
+            p.numVisited += this->visTree.NumVisitedNodes;
+            p.numReused += this->visTree.NumReusedNodes;
+        }
+        this->freeGeoms();
+        // the invariants only hold directly after the traversal, an arriving
+        // geom for a merging inner node is only used by the next traversal
+        if (opts.stress) {
+            // the check's scratch allocations don't count
+            const int64_t checkAllocs = AllocCount::Total();
+            if (!this->visTree.CheckInvariants()) {
+                Log::Warn("frame %d: VisTree invariants broken\n", frame);
+                if (++numInvalid > 5) {
+                    break;
+                }
+            }
+            frameAllocs += AllocCount::Total() - checkAllocs;
+        }
+        start = Clock::Now();
+        const int maxJobs = opts.stress ? rnd(4) : settings.JobsPerFrame;
+        if (this->useWorkers) {
+            this->processBatch(maxJobs, opts.failRate);
+        }
+        else {
+            this->processJobs(maxJobs, opts.failRate);
+        }
+        const Duration jobDt = Clock::Since(start);
+        jobTime += jobDt;
+        totalJobTime += jobDt;
+        cpuTime += jobDt;
+        int numDrawGeoms = 0;
+        int numDrawQuads = 0;
+        start = Clock::Now();
+        this->countDraws(numDrawGeoms, numDrawQuads);
+        drawListTime += Clock::Since(start);
+        drawGeoms += numDrawGeoms;
+        drawQuads += numDrawQuads;
+        if ((editFrame >= 0) && (0 == this->visTree.NumStaleDrawNodes())) {
+            editLatencyFrames += frame - editFrame;
+            editLatency += Clock::Since(editStart);
+            numEditsVisible++;
+            editFrame = -1;
+        }
+        if (frame >= opts.warmupFrames) {
+            // the max usage of the two halves after the warm-up
+            growth& g = growthHalves[secondHalf ? 1 : 0];
+            // the chunk store is capped and fills up over many frames, it doesn't count
+            g.Update(this->visTree.NumNodes() - this->visTree.NumFreeNodes(), this->visTree.NodeMemory(),
+                MemTrack::Total(MemTrack::CPU) - MemTrack::Current(MemTrack::Store, MemTrack::CPU));
+            const int64_t n = AllocCount::Total() - frameAllocs;
+            if (n > 0) {
+                if (noAlloc && (numAllocFrames < 5)) {
+                    Log::Warn("frame %d: %d heap allocations\n", frame, int(n));
+                }
+                numAllocs += n;
+                numAllocFrames++;
+            }
+        }
+        if ((reportFrames - 1) == (frame % reportFrames)) {
+            Log::Info("frame %6d: nodes %d (peak %d, %d KB), free geoms %d, jobs %d (%d failed), quads %d, traverse %.3f ms avg %.3f ms max, jobs %.3f ms/frame\n",
+                frame + 1,
+                this->visTree.NumNodes() - this->visTree.NumFreeNodes(),
+                this->visTree.MaxUsedNodes,
+                this->visTree.NodeMemory() / 1024,
+                this->geomPool.NumFree(),
+                this->numJobs, this->numFailedJobs, this->numQuads,
+                traverseTime.AsMilliSeconds() / reportFrames,
+                maxTraverseTime.AsMilliSeconds(),
+                jobTime.AsMilliSeconds() / reportFrames);
+            traverseTime = Duration();
+            maxTraverseTime = Duration();
+            jobTime = Duration();
+        }
+    }
+    this->DrawHash = this->drawHash();
+    this->NumDrawNodes = this->visTree.drawNodes.Size();
+    this->AvgDrawQuads = numFrames ? double(drawQuads) / numFrames : 0.0;
+    this->AvgDraws = numFrames ? double(drawGeoms) / numFrames : 0.0;
+    this->AvgJobTime = this->numJobs ? totalJobTime.AsMilliSeconds() / this->numJobs : 0.0;
+    this->AvgEditLatency = numEditsVisible ? editLatency.AsMilliSeconds() / numEditsVisible : 0.0;
+    this->PeakMemory = MemTrack::TotalPeak(MemTrack::CPU) + MemTrack::TotalPeak(MemTrack::GPU);
+    this->AvgJobLatency = this->numJobs ? double(this->jobLatency) / this->numJobs : 0.0;
+    this->AvgCPUTime = numFrames ? cpuTime.AsMilliSeconds() / numFrames : 0.0;
+    this->AvgGeomsPerChunk = this->numChains ? double(this->numChainGeoms) / this->numChains : 0.0;
+    this->MaxGeomsPerChunk = this->maxChainGeoms;
+    this->NumFailedJobs = this->numFailedJobs;
+    this->GeomGPUMemory = this->geomPool.gpuBytes;
+    this->AvgDrawListTime = numFrames ? drawListTime.AsMilliSeconds() / numFrames : 0.0;
+    const ChunkStore& store = this->chunkSource.Store;
+    Log::Info("%s: %d frames, %d failed splits, %d recycled roots, %d purged jobs, store %d chunks (%d KB, %d hits, %d misses)\n",
+        opts.scenario, numFrames, this->visTree.NumFailedSplits, this->visTree.NumRecycledRoots, this->visTree.NumPurgedJobs,
+        store.NumChunks(), store.CompressedMemory() / 1024, store.NumHits, store.NumMisses);
+    Log::Info("job hash %08x, draw hash %08x (%d draw nodes)\n", this->JobHash, this->DrawHash, this->NumDrawNodes);
+    Log::Info("chunk size %d, drawn quads %.0f avg in %.1f geoms, peak memory %d KB, job latency %.2f frames avg (%d max), %.3f ms/job, cpu %.3f ms/frame\n",
+        settings.ChunkSize, this->AvgDrawQuads, this->AvgDraws, int(this->PeakMemory / 1024),
+        this->AvgJobLatency, this->MaxJobLatency, this->AvgJobTime, this->AvgCPUTime);
+    Log::Info("geom chains (%s indices): %.2f geoms per chunk avg (%d max), %d failed jobs (geom pool empty or -failrate)\n",
+        opts.index32 ? "32-bit" : "16-bit", this->AvgGeomsPerChunk, this->MaxGeomsPerChunk, this->numFailedJobs);
+    if (opts.pan) {
+        const phase& idle = this->Phases[0];
+        const phase& pan = this->Phases[1];
+        Log::Info("pan (temporal coherence %s): idle %.4f ms/traverse (%.1f visited, %.1f reused nodes), slow pan %.4f ms/traverse (%.1f visited, %.1f reused nodes)\n",
+            opts.noCoherence ? "off" : "on",
+            idle.numFrames ? idle.traverseTime.AsMilliSeconds() / idle.numFrames : 0.0,
+            idle.numFrames ? double(idle.numVisited) / idle.numFrames : 0.0,
+            idle.numFrames ? double(idle.numReused) / idle.numFrames : 0.0,
+            pan.numFrames ? pan.traverseTime.AsMilliSeconds() / pan.numFrames : 0.0,
+            pan.numFrames ? double(pan.numVisited) / pan.numFrames : 0.0,
+            pan.numFrames ? double(pan.numReused) / pan.numFrames : 0.0);
+    }
+    if (this->chunkSource.Edits.NumEdits() > 0) {
+        Log::Info("edits: %d, %d visible, %d dirty nodes, %d remesh jobs, avg latency %.1f frames (%.3f ms)\n",
+            this->chunkSource.Edits.NumEdits(), numEditsVisible, this->visTree.NumDirtyNodes, this->visTree.NumRemeshJobs,
+            numEditsVisible ? double(editLatencyFrames) / numEditsVisible : 0.0,
+            numEditsVisible ? editLatency.AsMilliSeconds() / numEditsVisible : 0.0);
+    }
+    if (opts.stress) {
+        Log::Info("invariants: %s\n", numInvalid ? "BROKEN" : "ok");
+    }
+    if (AllocCount::Available()) {
+        Log::Info("heap allocations after %d warm-up frames: %d in %d frames%s\n",
+            opts.warmupFrames, int(numAllocs), numAllocFrames,
+            noAlloc ? (numAllocs ? " (FAILED)" : " (ok)") : "");
+    }
+    else {
+        Log::Info("heap allocations: not counted on this platform\n");
+        numAllocs = 0;
+    }
+    const bool allocFailed = noAlloc && (numAllocs > 0);
+    bool longFailed = false;
+    if (opts.longFlight) {
+        const growth& a = growthHalves[0];
+        const growth& b = growthHalves[1];
+        longFailed = (0 == this->visTree.NumRecycledRoots) || b.Exceeds(a);
+        Log::Info("long flight: %d recycled roots, max used nodes %d -> %d, node memory %d -> %d KB, cpu memory %d -> %d KB (first -> second half)%s\n",
+            this->visTree.NumRecycledRoots, a.nodes, b.nodes, a.nodeMemory / 1024, b.nodeMemory / 1024,
+            int(a.cpuMemory / 1024), int(b.cpuMemory / 1024), longFailed ? " (FAILED)" : " (ok)");
+    }
+
+    MemTrack::Dump();
+    if (opts.recordPath && !opts.replayPath) {
+        this->cameraPath.Save(opts.recordPath);
+    }
+    this->visTree.Discard();
+    if (this->useWorkers) {
+        this->workers.Discard();
+    }
+    this->chunkSource.Discard();
+    this->geomMesher.Discard();
+    this->geomPool.Discard();
+    return !(numInvalid || allocFailed || longFailed);
+}
+
+//------------------------------------------------------------------------------
+static bool
+compareRuns(const simulation& ref, int refThreads, const simulation& sim, int numThreads) {
+    bool ok = true;
+    if (ref.JobHash != sim.JobHash) {
+        Log::Warn("%d vs %d threads: job sequences differ\n", refThreads, numThreads);
+        ok = false;
+    }
+    if ((ref.DrawHash != sim.DrawHash) || (ref.NumDrawNodes != sim.NumDrawNodes)) {
+        Log::Warn("%d vs %d threads: final draw lists differ\n", refThreads, numThreads);
+        ok = false;
+    }
+    if (ref.Chunks.Size() != sim.Chunks.Size()) {
+        Log::Warn("%d vs %d threads: %d vs %d chunks\n", refThreads, numThreads, ref.Chunks.Size(), sim.Chunks.Size());
+        ok = false;
+    }
+    int numMismatches = 0;
+    for (int i = 0; i < ref.Chunks.Size(); i++) {
+        const chunkKey& key = ref.Chunks.KeyAtIndex(i);
+        const chunkHash& a = ref.Chunks.ValueAtIndex(i);
+        const int j = sim.Chunks.FindIndex(key);
+        const bool missing = InvalidIndex == j;
+        if (missing || (a.voxels != sim.Chunks.ValueAtIndex(j).voxels) || (a.mesh != sim.Chunks.ValueAtIndex(j).mesh)) {
+            if (numMismatches++ < 5) {
+                Log::Warn("%d vs %d threads: chunk lvl %d x %d y %d %s\n", refThreads, numThreads,
+                    key.level, int(key.x), int(key.y),
+                    missing ? "missing" : ((a.voxels != sim.Chunks.ValueAtIndex(j).voxels) ? "voxels differ" : "mesh differs"));
+            }
+        }
+    }
+    if (numMismatches > 0) {
+        Log::Warn("%d vs %d threads: %d of %d chunks differ\n", refThreads, numThreads, numMismatches, ref.Chunks.Size());
+        ok = false;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+/// one run of a sweep
+struct sweepRun {
+    Settings settings;
+    bool ok = false;
+    double quads = 0.0;
+    int64_t memory = 0;
+    double latency = 0.0;
+    double cpuTime = 0.0;
+    double draws = 0.0;
+    double jobTime = 0.0;
+    double editLatency = 0.0;
+    bool pareto = false;
+};
+
+//------------------------------------------------------------------------------
+static bool
+dominates(const sweepRun& a, const sweepRun& b) {
+    // more (or as many) quads for at most the cost, and better in one of them
+    if (!((a.quads >= b.quads) && (a.memory <= b.memory) && (a.latency <= b.latency) && (a.cpuTime <= b.cpuTime))) {
+        return false;
+    }
+    return (a.quads > b.quads) || (a.memory < b.memory) || (a.latency < b.latency) || (a.cpuTime < b.cpuTime);
+}
+
+//------------------------------------------------------------------------------
+static bool
+sweep(options opts, const char* spec, int numThreads) {
+    // parse "knob=v0,v1,... knob=..." into axes
+    static const int MaxSpecLength = 1024;
+    char buf[MaxSpecLength];
+    if (strlen(spec) >= sizeof(buf)) {
+        Log::Warn("sweep: spec too long\n");
+        return false;
+    }
+    strcpy(buf, spec);
+    struct axis {
+        const char* knob = nullptr;
+        int knobIndex = 0;
+        Array<const char*> values;
+    };
+    axis axes[Settings::NumKnobs];
+    int numAxes = 0;
+    int numRuns = 1;
+    for (char* item = strtok(buf, " "); item; item = strtok(nullptr, " ")) {
+        char* eq = strchr(item, '=');
+        if (!eq || (numAxes == Settings::NumKnobs)) {
+            Log::Warn("sweep: expected 'knob=v0,v1,...', got '%s'\n", item);
+            return false;
+        }
+        *eq = 0;
+        axis& a = axes[numAxes++];
+        a.knob = item;
+        a.knobIndex = InvalidIndex;
+        for (int i = 0; i < Settings::NumKnobs; i++) {
+            if (0 == strcmp(item, Settings::Name(i))) {
+                a.knobIndex = i;
+            }
+        }
+        for (char* val = eq + 1; val; ) {
+            char* comma = strchr(val, ',');
+            if (comma) {
+                *comma = 0;
+            }
+            // check the value now, not halfway through the sweep
+            Settings check;
+            if (!check.Set(a.knob, val)) {
+                return false;
+            }
+            a.values.Add(val);
+            val = comma ? comma + 1 : nullptr;
+        }
+        numRuns *= a.values.Size();
+    }
+    if (0 == numAxes) {
+        Log::Warn("sweep: no knobs given\n");
+        return false;
+    }
+
+    // run the grid, the first axis changes slowest
+    Array<sweepRun> runs;
+    runs.Reserve(numRuns);
+    for (int runIndex = 0; runIndex < numRuns; runIndex++) {
+        sweepRun& run = runs.Add();
+        run.settings = opts.settings;
+        int rest = runIndex;
+        for (int i = numAxes - 1; i >= 0; i--) {
+            run.settings.Set(axes[i].knob, axes[i].values[rest % axes[i].values.Size()]);
+            rest /= axes[i].values.Size();
+        }
+        Log::Info("--- sweep run %d/%d:", runIndex + 1, numRuns);
+        for (int i = 0; i < numAxes; i++) {
+            Log::Info(" %s=%g", axes[i].knob, run.settings.Get(axes[i].knobIndex));
+        }
+        Log::Info("\n");
+        options runOpts = opts;
+        runOpts.settings = run.settings;
+        simulation* sim = Memory::New<simulation>();
+        run.ok = sim->Run(runOpts, numThreads, false);
+        run.quads = sim->AvgDrawQuads;
+        run.memory = sim->PeakMemory;
+        run.latency = sim->AvgJobLatency;
+        run.cpuTime = sim->AvgCPUTime;
+        run.draws = sim->AvgDraws;
+        run.jobTime = sim->AvgJobTime;
+        run.editLatency = sim->AvgEditLatency;
+        Memory::Delete(sim);
+    }
+
+    // mark the Pareto front, failed runs are never on it
+    for (sweepRun& run : runs) {
+        run.pareto = run.ok;
+        for (const sweepRun& other : runs) {
+            if (other.ok && dominates(other, run)) {
+                run.pareto = false;
+                break;
+            }
+        }
+    }
+    Log::Info("\nsweep: %s, %d runs, * = Pareto front (more drawn quads for less memory, job latency and CPU time)\n\n",
+        opts.scenario, numRuns);
+    Log::Info("  ");
+    for (int i = 0; i < numAxes; i++) {
+        Log::Info(" %12s", axes[i].knob);
+    }
+    // draws, time per job and edit latency are informational, they don't affect the front
+    Log::Info(" | %10s %10s %12s %10s | %8s %8s%s\n", "quads", "mem KB", "latency fr", "cpu ms",
+        "draws", "job ms", opts.edit ? "  edit ms" : "");
+    for (const sweepRun& run : runs) {
+        Log::Info("%s ", run.pareto ? "*" : (run.ok ? " " : "!"));
+        for (int i = 0; i < numAxes; i++) {
+            Log::Info(" %12g", run.settings.Get(axes[i].knobIndex));
+        }
+        Log::Info(" | %10.0f %10d %12.2f %10.3f | %8.1f %8.3f",
+            run.quads, int(run.memory / 1024), run.latency, run.cpuTime, run.draws, run.jobTime);
+        if (opts.edit) {
+            Log::Info(" %8.2f", run.editLatency);
+        }
+        Log::Info("%s\n", run.ok ? "" : " (failed)");
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/// run the scenario with 16- and 32-bit indices and compare the draws
+static bool
+compareIndexModes(options opts, int numThreads) {
+    simulation* sims[2] = { };
+    bool ok = true;
+    for (int i = 0; (i < 2) && ok; i++) {
+        opts.index32 = 1 == i;
+        Log::Info("--- %s indices\n", opts.index32 ? "32-bit" : "16-bit");
+        sims[i] = Memory::New<simulation>();
+        ok = sims[i]->Run(opts, numThreads, false);
+        // only record the first run
+        opts.recordPath = nullptr;
+    }
+    if (ok) {
+        Log::Info("\nindex modes: %s%s, chunk size %d, %d geoms (+%d large in 32-bit mode)\n\n",
+            opts.scenario, opts.checkerboard ? " (checkerboard)" : "", opts.settings.ChunkSize,
+            opts.settings.NumGeoms, NumLargeGeoms);
+        Log::Info("%-8s %10s %10s %12s %10s %12s %6s %8s %10s %10s\n",
+            "index", "draws", "gfx calls", "drawn quads", "quads/draw", "geoms/chunk", "max", "failed", "geom KB", "walk ms");
+        for (int i = 0; i < 2; i++) {
+            const simulation& sim = *sims[i];
+            // each drawn geom applies a draw state and uniform block and issues a draw
+            Log::Info("%-8s %10.1f %10.1f %12.0f %10.0f %12.2f %6d %8d %10d %10.4f\n",
+                i ? "32-bit" : "16-bit", sim.AvgDraws, sim.AvgDraws * 3, sim.AvgDrawQuads,
+                sim.AvgDraws > 0.0 ? sim.AvgDrawQuads / sim.AvgDraws : 0.0,
+                sim.AvgGeomsPerChunk, sim.MaxGeomsPerChunk, sim.NumFailedJobs,
+                int(sim.GeomGPUMemory / 1024), sim.AvgDrawListTime);
+        }
+        if (sims[0]->AvgDraws > 0.0) {
+            Log::Info("\n32-bit indices: %.1f%% draw calls at %.1f%% drawn quads\n",
+                100.0 * sims[1]->AvgDraws / sims[0]->AvgDraws,
+                sims[0]->AvgDrawQuads > 0.0 ? 100.0 * sims[1]->AvgDrawQuads / sims[0]->AvgDrawQuads : 0.0);
+        }
+    }
+    for (simulation* sim : sims) {
+        if (sim) {
+            Memory::Delete(sim);
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+/// run the scenario with and without temporal coherence and compare the traversals
+static bool
+compareCoherence(options opts, int numThreads) {
+    simulation* sims[2] = { };
+    bool ok = true;
+    for (int i = 0; (i < 2) && ok; i++) {
+        opts.noCoherence = 1 == i;
+        Log::Info("--- temporal coherence %s\n", opts.noCoherence ? "off" : "on");
+        sims[i] = Memory::New<simulation>();
+        ok = sims[i]->Run(opts, numThreads, false);
+        // only record the first run
+        opts.recordPath = nullptr;
+    }
+    if (ok) {
+        const char* phaseNames[2] = { opts.pan ? "idle" : opts.scenario, "slow pan" };
+        Log::Info("\ncoherence: %s, %d frames after %d warm-up frames\n\n",
+            opts.scenario, opts.numFrames - opts.warmupFrames, opts.warmupFrames);
+        Log::Info("%-10s %-10s %8s %12s %12s %12s\n",
+            "phase", "coherence", "frames", "traverse ms", "visited", "reused");
+        for (int p = 0; p < 2; p++) {
+            for (int i = 0; i < 2; i++) {
+                const simulation::phase& ph = sims[i]->Phases[p];
+                if (0 == ph.numFrames) {
+                    continue;
+                }
+                Log::Info("%-10s %-10s %8d %12.4f %12.1f %12.1f\n",
+                    phaseNames[p], i ? "off" : "on", ph.numFrames,
+                    ph.traverseTime.AsMilliSeconds() / ph.numFrames,
+                    double(ph.numVisited) / ph.numFrames, double(ph.numReused) / ph.numFrames);
+            }
+        }
+    }
+    for (simulation* sim : sims) {
+        if (sim) {
+            Memory::Delete(sim);
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, const char** argv) {
+    Core::Setup();
+    Trace::Setup();
+    options opts;
+    opts.scenario = arg(argc, argv, "-scenario", "flight");
+    opts.numFrames = atoi(arg(argc, argv, "-frames", "10000"));
+    opts.failRate = atoi(arg(argc, argv, "-failrate", "0"));
+    opts.warmupFrames = atoi(arg(argc, argv, "-warmup", "600"));
+    opts.seed = uint32_t(atoi(arg(argc, argv, "-seed", "1")));
+    opts.stress = 0 == strcmp(opts.scenario, "stress");
+    opts.flight = 0 == strcmp(opts.scenario, "flight");
+    opts.edit = 0 == strcmp(opts.scenario, "edit");
+    opts.longFlight = 0 == strcmp(opts.scenario, "long");
+    opts.pan = 0 == strcmp(opts.scenario, "pan");
+    if (!(opts.stress || opts.flight || opts.edit || opts.longFlight || opts.pan)) {
+        Log::Warn("unknown scenario '%s'\n", opts.scenario);
+        Core::Discard();
+        return 10;
+    }
+    opts.noAlloc = opts.flight || flag(argc, argv, "-noalloc");
+    opts.checkerboard = flag(argc, argv, "-checkerboard");
+    opts.index32 = flag(argc, argv, "-index32");
+    opts.noCoherence = flag(argc, argv, "-nocoherence");
+    opts.recordPath = arg(argc, argv, "-record", nullptr);
+    opts.replayPath = arg(argc, argv, "-replay", nullptr);
+    int numThreads = atoi(arg(argc, argv, "-threads", "0"));
+    const char* configPath = arg(argc, argv, "-config", nullptr);
+    bool ok = !configPath || opts.settings.Load(configPath);
+    if (const char* budget = arg(argc, argv, "-budget", nullptr)) {
+        ok &= opts.settings.Set("nodes", budget);
+    }
+    for (int i = 0; i < Settings::NumKnobs; i++) {
+        char argName[32];
+        snprintf(argName, sizeof(argName), "-%s", Settings::Name(i));
+        if (const char* val = arg(argc, argv, argName, nullptr)) {
+            ok &= opts.settings.Set(Settings::Name(i), val);
+        }
+    }
+    const char* sweepSpec = arg(argc, argv, "-sweep", nullptr);
+    if (!ok) {
+        // invalid settings, already reported
+    }
+    else if (sweepSpec) {
+        ok = sweep(opts, sweepSpec, numThreads);
+    }
+    else if (flag(argc, argv, "-compareindex")) {
+        opts.settings.Dump();
+        ok = compareIndexModes(opts, numThreads);
+    }
+    else if (flag(argc, argv, "-comparecoherence")) {
+        opts.settings.Dump();
+        ok = compareCoherence(opts, numThreads);
+    }
+    else if (flag(argc, argv, "-verify")) {
+        if (numThreads < 4) {
+            const int numCores = int(std::thread::hardware_concurrency());
+            numThreads = numCores > 4 ? numCores : 4;
+        }
+        const int runThreads[] = { 1, 2, numThreads };
+        const int numRuns = sizeof(runThreads) / sizeof(int);
+        simulation* sims[numRuns] = { };
+        for (int i = 0; (i < numRuns) && ok; i++) {
+            Log::Info("--- %d thread(s)\n", runThreads[i]);
+            sims[i] = Memory::New<simulation>();
+            ok &= sims[i]->Run(opts, runThreads[i], true);
+            if (ok && (i > 0)) {
+                ok &= compareRuns(*sims[0], runThreads[0], *sims[i], runThreads[i]);
+            }
+            // only record the first run
+            opts.recordPath = nullptr;
+        }
+        if (ok) {
+            Log::Info("verify: %d chunks, job sequences, chunk hashes and draw lists match for 1, 2 and %d threads\n",
+                sims[0]->Chunks.Size(), numThreads);
+        }
+        else {
+            Log::Info("verify: FAILED\n");
+        }
+        for (simulation* sim : sims) {
+            if (sim) {
+                Memory::Delete(sim);
+            }
+        }
+    }
+    else {
+        opts.settings.Dump();
+        simulation* sim = Memory::New<simulation>();
+        ok = sim->Run(opts, numThreads, false);
+        Memory::Delete(sim);
+    }
+
+    const char* tracePath = arg(argc, argv, "-trace", nullptr);
+    if (tracePath) {
+        Trace::Write(tracePath);
+    }
+    Trace::Discard();
+    Core::Discard();
+    return ok ? 0 : 10;
+}